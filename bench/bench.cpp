@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "console.h"
+#include "core/archive.h"
+#include "core/battery.h"
+#include "core/paths.h"
+#include "core/query.h"
+#include "core/registry.h"
+#include "core/storage.h"
+#include "tools/fixture.h"
+#include "ui/mainwindow.h"
+
+struct Result {
+    QString name;
+    qint64 iterations;
+    double min;
+    double median;
+    double mean;
+    double p95;
+    double stddev;
+};
+
+/*
+ * Runs every benchmark for a number of samples of a fixed batch of calls
+ * and keeps per-call statistics, the first sample is a discarded warm-up.
+ */
+class Bench
+{
+public:
+    int samples = 20;
+    QString filter;
+    QList<Result> results;
+
+    void run(const QString &name, qint64 iterations, std::function<void()> function)
+    {
+        if (!filter.isEmpty() && !name.contains(filter))
+            return;
+
+        QVector<double> times;
+        QElapsedTimer timer;
+
+        for (int sample = 0; sample <= samples; sample++) {
+            timer.start();
+            for (qint64 i = 0; i < iterations; i++)
+                function();
+            double elapsed = timer.nsecsElapsed() / (double) iterations;
+            if (sample > 0)
+                times.append(elapsed);
+        }
+
+        std::sort(times.begin(), times.end());
+
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.min = times.first();
+        result.median = times[times.size() / 2];
+        result.p95 = times[std::min(times.size() - 1, (int) ceil(times.size() * 0.95) - 1)];
+        result.mean = 0;
+        for (double time : times)
+            result.mean += time;
+        result.mean /= times.size();
+        result.stddev = 0;
+        for (double time : times)
+            result.stddev += (time - result.mean) * (time - result.mean);
+        result.stddev = sqrt(result.stddev / times.size());
+
+        results.append(result);
+        fprintf(stderr, "%-36s %12.0f ns/op (min %.0f, p95 %.0f)\n", name.toLocal8Bit().constData(),
+                result.median, result.min, result.p95);
+    }
+};
+
+static volatile int sink;
+
+static int stdoutBackup = -1;
+
+/* The console paths print, keep that out of the JSON on stdout */
+static void silenceStdout(bool silence)
+{
+    fflush(stdout);
+    if (silence) {
+        stdoutBackup = dup(STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    } else {
+        qStdOut().flush();
+        fflush(stdout);
+        dup2(stdoutBackup, STDOUT_FILENO);
+        close(stdoutBackup);
+    }
+}
+
+QJsonDocument toJson(const Bench &bench, const Fixture &fixture)
+{
+    QJsonArray results;
+    for (const Result &result : bench.results) {
+        QJsonObject object;
+        object["name"] = result.name;
+        object["iterations"] = result.iterations;
+        object["min_ns"] = result.min;
+        object["median_ns"] = result.median;
+        object["mean_ns"] = result.mean;
+        object["p95_ns"] = result.p95;
+        object["stddev_ns"] = result.stddev;
+        results.append(object);
+    }
+
+    QJsonObject setup;
+    setup["batteries"] = fixture.batteries;
+    setup["peripherals"] = fixture.peripherals;
+    setup["samples"] = bench.samples;
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["fixture"] = setup;
+    root["results"] = results;
+    return QJsonDocument(root);
+}
+
+int compare(const Bench &bench, const QString &file, double threshold)
+{
+    QFile baselineFile(file);
+    if (!baselineFile.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Cannot open baseline %s\n", file.toLocal8Bit().constData());
+        return 2;
+    }
+
+    QJsonArray baseline = QJsonDocument::fromJson(baselineFile.readAll()).object()["results"].toArray();
+    int regressions = 0;
+
+    for (const Result &result : bench.results) {
+        for (const QJsonValue &value : baseline) {
+            QJsonObject object = value.toObject();
+            if (object["name"].toString() != result.name)
+                continue;
+            double before = object["median_ns"].toDouble();
+            double change = before > 0 ? (result.median - before) / before * 100.0 : 0;
+            bool regressed = change > threshold;
+            fprintf(stderr, "%-36s %12.0f -> %12.0f ns/op %+7.1f%% %s\n", result.name.toLocal8Bit().constData(),
+                    before, result.median, change, regressed ? "REGRESSION" : "");
+            if (regressed)
+                regressions++;
+        }
+    }
+
+    return regressions == 0 ? 0 : 1;
+}
+
+int checkBudget(const Bench &bench, double budget)
+{
+    int over = 0;
+
+    /* Whole runs of the console binary, from exec to exit */
+    for (const Result &result : bench.results) {
+        if (!result.name.endsWith(".process"))
+            continue;
+        bool exceeded = result.median > budget * 1000000.0;
+        fprintf(stderr, "%-36s %12.2f ms of %.2f ms %s\n", result.name.toLocal8Bit().constData(),
+                result.median / 1000000.0, budget, exceeded ? "OVER BUDGET" : "");
+        if (exceeded)
+            over++;
+    }
+
+    return over == 0 ? 0 : 1;
+}
+
+void printUsage()
+{
+    fprintf(stderr,
+            "Usage: batteryctl_bench [options]\n"
+            "\n"
+            "   --batteries (n)\t\tLaptop batteries in the generated fixture (2)\n"
+            "   --peripherals (n)\t\tPeripheral batteries in the generated fixture (0)\n"
+            "   --samples (n)\t\tSamples per benchmark (20)\n"
+            "   --filter (text)\t\tOnly run benchmarks whose name contains text\n"
+            "   --output (file)\t\tWrite the JSON results to file instead of stdout\n"
+            "   --compare (file)\t\tFail when a median regressed against this baseline\n"
+            "   --threshold (percent)\tAllowed regression for --compare (10)\n"
+            "   --budget (ms)\t\tFail when a cold console run takes longer\n"
+            "\n");
+}
+
+int main(int argc, char **argv)
+{
+    /* MainWindow::refreshData needs a QApplication, not a display */
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    QTemporaryDir directory;
+    Fixture fixture(directory.path().toStdString());
+    Bench bench;
+    QString output;
+    QString baseline;
+    double threshold = 10;
+    double budget = 0;
+
+    for (int i = 1; i < arguments.size(); i++) {
+        QString option = arguments[i];
+        if (option == "--help") {
+            printUsage();
+            return 0;
+        }
+        if (i + 1 >= arguments.size()) {
+            fprintf(stderr, "Missing value for %s, see --help\n", option.toLocal8Bit().constData());
+            return 2;
+        }
+        QString value = arguments[++i];
+        if (option == "--batteries")
+            fixture.batteries = value.toInt();
+        else if (option == "--peripherals")
+            fixture.peripherals = value.toInt();
+        else if (option == "--samples")
+            bench.samples = std::max(1, value.toInt());
+        else if (option == "--filter")
+            bench.filter = value;
+        else if (option == "--output")
+            output = value;
+        else if (option == "--compare")
+            baseline = value;
+        else if (option == "--threshold")
+            threshold = value.toDouble();
+        else if (option == "--budget")
+            budget = value.toDouble();
+        else {
+            fprintf(stderr, "Unknown option: %s, see --help\n", option.toLocal8Bit().constData());
+            return 2;
+        }
+    }
+
+    if (!directory.isValid() || !fixture.create())
+        return 2;
+
+    Paths::setSysfsRoot(QString::fromStdString(fixture.getRoot()));
+    Paths::setConfigFile(QString::fromStdString(fixture.getConfigFile()));
+
+    Registry *registry = Registry::getRegistry();
+    Storage *storage = Storage::getStorage();
+
+    if (registry->getBatteries().isEmpty()) {
+        fprintf(stderr, "The fixture has no batteries\n");
+        return 2;
+    }
+
+    QString name = registry->getBatteries().first().name;
+    unsigned int tick = 0;
+    int value = 0;
+
+    bench.run("registry.scan", 200, [&]() {
+        registry->scan();
+    });
+
+    Battery battery;
+    bench.run("battery.readBattery", 1000, [&]() {
+        battery.readBattery(name);
+    });
+
+    bench.run("battery.readBattery.churn", 200, [&]() {
+        fixture.churn(++tick);
+        battery.readBattery(name);
+    });
+
+    bench.run("battery.readBattery.cold", 200, [&]() {
+        Battery cold;
+        cold.readBattery(name);
+        sink = cold.capacity;
+    });
+
+    QString unknown("Unknown");
+    bench.run("battery.guessBatteryStatus", 100000, [&]() {
+        sink = Battery::guessBatteryStatus(&battery, unknown).size();
+    });
+
+    bench.run("storage.getStartThreshold", 10000, [&]() {
+        sink = storage->getStartThreshold(name);
+    });
+
+    bench.run("storage.getStopThreshold", 10000, [&]() {
+        sink = storage->getStopThreshold(name);
+    });
+
+    bench.run("storage.getSettingType", 10000, [&]() {
+        sink = storage->getSettingType(name).size();
+    });
+
+    bench.run("storage.setStartThreshold", 100, [&]() {
+        storage->setStartThreshold(name, value++ % 50);
+    });
+
+    bench.run("storage.setStopThreshold", 100, [&]() {
+        storage->setStopThreshold(name, 51 + value++ % 49);
+    });
+
+    bench.run("storage.setSettingType", 100, [&]() {
+        storage->setSettingType(name, value++ % 2 ? SETTING_LIFE : SETTING_AC);
+    });
+
+    silenceStdout(true);
+
+    bench.run("console.restoreSettings", 50, [&]() {
+        restoreSettings();
+    });
+
+    bench.run("console.info", 200, [&]() {
+        printBatteries();
+    });
+
+    silenceStdout(false);
+
+#ifdef BATTERYCTL_BINARY
+    /* Cold starts of the QtCore-only binary, without a daemon to forward to */
+    QStringList global = { "--local", "--sysfs-root", QString::fromStdString(fixture.getRoot()),
+                           "--config", QString::fromStdString(fixture.getConfigFile()) };
+    bench.run("console.info.process", 20, [&]() {
+        QProcess process;
+        process.setStandardOutputFile(QProcess::nullDevice());
+        process.start(BATTERYCTL_BINARY, global + QStringList("info"));
+        process.waitForFinished();
+    });
+
+    bench.run("console.restore.process", 20, [&]() {
+        QProcess process;
+        process.setStandardOutputFile(QProcess::nullDevice());
+        process.start(BATTERYCTL_BINARY, global + QStringList("restore"));
+        process.waitForFinished();
+    });
+#endif
+
+    /* A week of 1 Hz samples, summarized the way fleet scripts ask for it */
+    QString week = directory.path() + "/week.archive";
+    ArchiveWriter writer(week);
+    HistoryRecord record;
+    memset(&record, 0, sizeof(record));
+    writer.open();
+    for (int i = 0; i < 7 * 86400; i++) {
+        record.timestamp = 1500000000000LL + i * 1000LL;
+        record.capacity = 100 - i / 600 % 100;
+        record.energy_now = 50000000 - i % 60000 * 800;
+        record.power_now = 8000000 + i * 7919 % 500000;
+        record.voltage_now = 12000000 - i % 60000 * 40;
+        writer.append(record, name);
+    }
+    writer.finish();
+
+    ArchiveReader reader(week);
+    reader.open();
+    bench.run("history.query.week", 5, [&]() {
+        HistoryQuery query(Archive::Column::PowerNow, 3600 * 1000);
+        query.scan(&reader);
+        sink = query.getResults().size();
+    });
+
+    bench.run("history.query.hour", 200, [&]() {
+        HistoryQuery query(Archive::Column::PowerNow, 5 * 60 * 1000);
+        query.setRange(record.timestamp - 3600 * 1000, record.timestamp + 1);
+        query.scan(&reader);
+        sink = query.getSkippedBlocks();
+    });
+
+    /* The window samples on its own thread, let the first snapshots arrive */
+    MainWindow window;
+    QElapsedTimer settle;
+    settle.start();
+    while (settle.elapsed() < 1000)
+        app.processEvents(QEventLoop::AllEvents, 50);
+
+    bench.run("mainwindow.refreshData", 200, [&]() {
+        window.refreshData();
+    });
+
+    QByteArray json = toJson(bench, fixture).toJson();
+
+    if (output.isEmpty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    } else {
+        QFile file(output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            fprintf(stderr, "Cannot write %s\n", output.toLocal8Bit().constData());
+            return 2;
+        }
+    }
+
+    int ret = 0;
+
+    if (!baseline.isEmpty())
+        ret = compare(bench, baseline, threshold);
+
+    if (budget > 0 && ret != 2)
+        ret = std::max(ret, checkBudget(bench, budget));
+
+    return ret;
+}
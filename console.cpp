@@ -0,0 +1,1082 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <QDateTime>
+#include <QDebug>
+
+#include "console.h"
+#include "core/battery.h"
+#include "core/attributes.h"
+#include "core/serializer.h"
+#include "core/estimator.h"
+#include "core/storage.h"
+#include "core/registry.h"
+#include "core/paths.h"
+#include "core/client.h"
+#include "core/control.h"
+#include "core/protocol.h"
+#include "core/history.h"
+#include "core/archive.h"
+#include "core/query.h"
+#include "core/fade.h"
+#include "core/exporter.h"
+#include "core/profiler.h"
+
+#define VERSION "1.20"
+#define GUI_BINARY "batteryctl-gui"
+
+QTextStream& qStdOut()
+{
+    static QTextStream ts( stdout );
+    return ts;
+}
+
+void printVersion()
+{
+    qStdOut() << (
+                     "batteryctl " VERSION "\n"
+                     "Copyright (C) 2018 The Thinkpads.org Team\n"
+                     "License: FreeBSD License (BSD 2-Clause) <https://www.freebsd.org/copyright/freebsd-license.html>.\n"
+                     "This is free software: you are free to change and redistribute it.\n"
+                     "There is NO WARRANTY, to the extent permitted by law.\n"
+                     "\n"
+                     "\n"
+                     "Written by Ognjen Galic\n"
+                     "See --help for more information\n"
+                     ""
+    );
+}
+
+void printHelp()
+{
+    qStdOut() << (
+                     "Usage:\n"
+                     "\n"
+                     "   info\t\t\t\t\t\tPrint detailed information about the batteries\n"
+                     "       --json\t\t\t\t\tAs one JSON document in raw kernel units\n"
+                     "       --format (text|json|csv)\t\tPick the output format\n"
+                     "   set\t\t\t\t\t\tSet a custom charge threshold for the batteries\n"
+                     "       start (battery) (value)  \t\tSet the start charge threshold\n"
+                     "       stop (battery) (value)\t\t\tSet the stop charge threshold\n"
+                     "       (battery) (start) (stop)\t\tSet both thresholds at once\n"
+                     "\n"
+                     "   preset (battery) (value)\t\t\tSet a preset charge start/stop threshold pair\n"
+                     "       full\t\t\t\t\tCharge the battery to 100% always (default)\n"
+                     "       ac\t\t\t\t\tCharge the battery to 100% but optimize for always AC\n"
+                     "       life\t\t\t\t\tOptimize for maximum battery life (cycles)\n"
+                     " \n"
+                     "   gui\t\t\t\t\t\tRun the Qt GUI\n"
+                     "   record [seconds]\t\t\t\tRecord the batteries to the history file every second\n"
+                     "   archive (file)\t\t\t\tCompact the history file into an archive\n"
+                     "   history\t\t\t\t\tSummarize the recorded samples in time buckets\n"
+                     "       --since (time) --until (time)\t\tEpoch seconds, ISO 8601 or back from now (-2h)\n"
+                     "       --bucket (duration)\t\t\tBucket size such as 30s, 5m, 1h or 1d (5m)\n"
+                     "       --field (name)\t\t\t\tcapacity, energy_now, power_now (default), voltage_now, ...\n"
+                     "       --battery (battery)\t\t\tOnly this battery\n"
+                     "       --archive (file)\t\t\tRead archives instead of the history file, repeatable\n"
+                     "   watch [--interval (s)] [--format (f)]\tPrint what changed, f is text, json, i3bar or waybar\n"
+                     "   export --textfile (dir) [--interval (s)]\tKeep batteryctl.prom there for node_exporter (15 s)\n"
+                     "   profile\t\t\t\t\tTime every sysfs read batteryctl makes\n"
+                     "       --iterations (n)\t\t\tReads per attribute (1000)\n"
+                     "       --battery (battery)\t\t\tOnly this battery\n"
+                     "       --outlier (us)\t\t\t\tCount the reads slower than this (1000)\n"
+                     "   fade\t\t\t\t\t\tProject when the batteries reach their replacement capacity\n"
+                     "   helper\t\t\t\t\tServe privileged requests from the GUI on stdin\n"
+                     "   restore [seconds]\t\t\t\tRestore the stored settings to the batteries, giving\n"
+                     "       \t\t\t\t\t\teach one this long (5, at most 20) before reporting a timeout\n"
+                     "   --help\t\t\t\t\tPrint this help\n"
+                     "   --version\t\t\t\t\tPrint the version\n"
+                     "\n"
+                     "Options (before the command):\n"
+                     "\n"
+                     "   --sysfs-root (dir)\t\t\t\tRead /sys from under another root (" SYSFS_ROOT_ENV ")\n"
+                     "   --config (file)\t\t\t\tUse another configuration file (" CONFIG_FILE_ENV ")\n"
+                     "   --fade (file)\t\t\t\tUse another capacity fade file (" FADE_FILE_ENV ")\n"
+                     "   --history (file)\t\t\t\tUse another history file (" HISTORY_FILE_ENV ")\n"
+                     "   --local\t\t\t\t\tDo not go through batteryctld\n"
+                     "\n"
+                     "A battery is either primary, secondary or a power_supply name such as BAT2.\n"
+                     "\n"
+                     "Examples:\n"
+                     "\n"
+                     " batteryctl info\t\t\t\tPrint the information\n"
+                     " batteryctl info --format=csv\t\t\tOne CSV row per battery for scripts\n"
+                     " batteryctl set start primary 45\t\tSet the charge threshold of the primary bat to 45\n"
+                     " batteryctl set stop primary 45\t\t\tSet the charge stop of the primary battery to 45\n"
+                     " batteryctl preset primary life\t\t\tOptimize the primary battery for battery life (cycles)\n"
+                     " batteryctl history --since -1d --bucket 1h\tHourly power draw over the last day\n\n"
+    );
+}
+
+void printBatteryInfo(Battery *bat) {
+
+    for (int i = 0; i < Attributes::count; i++) {
+        const char *label = Attributes::table[i].label;
+        if (label == nullptr)
+            continue;
+        /* Values line up at column 32 */
+        int tabs = 4 - (int) (strlen(label) + 1) / 8;
+        qStdOut() << label << ":" << QString(tabs, '\t') << Attributes::format(*bat, i) << "\n";
+    }
+
+}
+
+void printBatteries(Serializer::Format format)
+{
+    const QVector<PowerSupply> &batteries = Registry::getRegistry()->getBatteries();
+    Battery battery;
+
+    if (format != Serializer::Format::Text) {
+        QByteArray output;
+        Serializer serializer(format, &output);
+        serializer.begin();
+        for (const PowerSupply &supply : batteries) {
+            battery.readBattery(supply.name);
+            serializer.add(battery, supply.label());
+        }
+        serializer.end();
+        fwrite(output.constData(), 1, output.size(), stdout);
+        return;
+    }
+
+    if (batteries.isEmpty()) {
+        qStdOut() << "No batteries are installed.\n";
+        return;
+    }
+
+    for (const PowerSupply &supply : batteries) {
+        qStdOut() << supply.label() << " - Installed\n";
+        battery.readBattery(supply.name);
+        printBatteryInfo(&battery);
+        qStdOut() << "\n";
+    }
+}
+
+void printBatteries(const QByteArray &payload, Serializer::Format format)
+{
+    QList<Battery *> batteries;
+    QStringList labels;
+
+    Protocol::decodeBatteries(payload, &batteries, &labels);
+
+    if (format != Serializer::Format::Text) {
+        QByteArray output;
+        Serializer serializer(format, &output);
+        serializer.begin();
+        for (int i = 0; i < batteries.size(); i++)
+            serializer.add(*batteries[i], labels[i]);
+        serializer.end();
+        fwrite(output.constData(), 1, output.size(), stdout);
+        qDeleteAll(batteries);
+        return;
+    }
+
+    if (batteries.isEmpty())
+        qStdOut() << "No batteries are installed.\n";
+
+    for (int i = 0; i < batteries.size(); i++) {
+        qStdOut() << labels[i] << " - Installed\n";
+        printBatteryInfo(batteries[i]);
+        qStdOut() << "\n";
+    }
+
+    qDeleteAll(batteries);
+}
+
+int report(int ret, const QString &message)
+{
+    if (!message.isEmpty())
+        qStdOut() << message << "\n";
+    return ret;
+}
+
+int forward(const QByteArray &request, QByteArray *payload)
+{
+    QString message;
+
+    if (!Client::isEnabled())
+        return -1;
+
+    int ret = Client::request(request, payload, &message);
+    if (ret > 0)
+        return report(ret, message);
+    return ret;
+}
+
+int setThreshold(QString what, QString where, QString value_raw)
+{
+    QString message;
+    QByteArray payload;
+
+    int ret = forward("SET " + what.toUtf8() + " " + where.toUtf8() + " " + value_raw.toUtf8(), &payload);
+    if (ret >= 0)
+        return report(ret, QString::fromUtf8(payload));
+
+    return report(Control::setThreshold(what, where, value_raw, &message), message);
+}
+
+int setPreset(QString which, QString where)
+{
+    QString message;
+    QByteArray payload;
+
+    int ret = forward("PRESET " + where.toUtf8() + " " + which.toUtf8(), &payload);
+    if (ret >= 0)
+        return report(ret, QString::fromUtf8(payload));
+
+    return report(Control::setPreset(which, where, &message), message);
+}
+
+int restoreSettings(int deadline)
+{
+    QString message;
+    QByteArray payload;
+
+    int ret = forward("RESTORE " + QByteArray::number(deadline), &payload);
+    if (ret >= 0)
+        return report(ret, QString::fromUtf8(payload));
+
+    return report(Control::restore(&message, deadline), message);
+}
+
+static volatile sig_atomic_t recording;
+
+static void stopRecording(int)
+{
+    recording = 0;
+}
+
+static bool sameBatteries(const QList<Battery *> &batteries)
+{
+    const QVector<PowerSupply> &supplies = Registry::getRegistry()->getBatteries();
+
+    if (batteries.size() != supplies.size())
+        return false;
+    for (int i = 0; i < supplies.size(); i++)
+        if (batteries[i]->name != supplies[i].name)
+            return false;
+    return true;
+}
+
+int recordHistory(QString interval_raw)
+{
+    QList<Battery *> batteries;
+    History history(Paths::getHistoryFile());
+    struct timespec next;
+    struct timespec now;
+    time_t lastCommit;
+    quint64 count = 0;
+    bool ok = true;
+
+    int interval = interval_raw.isEmpty() ? 1 : interval_raw.toInt(&ok);
+    if (!ok || interval <= 0) {
+        qStdOut() << "Invalid interval: " << interval_raw << "\n";
+        return 1;
+    }
+
+    /* Only consulted when the file is created, see History */
+    if (!history.open(History::Mode::ReadWrite, Registry::getRegistry()->getBatteries().size())) {
+        qStdOut() << "Could not open the history file " << Paths::getHistoryFile() << "\n";
+        return 1;
+    }
+
+    recording = 1;
+    signal(SIGINT, stopRecording);
+    signal(SIGTERM, stopRecording);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    lastCommit = next.tv_sec;
+
+    while (recording) {
+        if (!sameBatteries(batteries)) {
+            qDeleteAll(batteries);
+            batteries.clear();
+            for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+                batteries.append(new Battery());
+                batteries.last()->readBattery(supply.name);
+            }
+        }
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        int64_t timestamp = now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+
+        for (Battery *battery : batteries) {
+            battery->readBattery(battery->name);
+            if (history.append(*battery, timestamp))
+                count++;
+            FadeModel::getFadeModel()->update(*battery, timestamp);
+        }
+
+        /* Only the commit touches the disk, everything else stays in the page cache */
+        if (next.tv_sec - lastCommit >= HISTORY_SYNC_INTERVAL) {
+            history.commit();
+            Registry::getRegistry()->scan();
+            lastCommit = next.tv_sec;
+        }
+
+        next.tv_sec += interval;
+        while (recording && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR)
+            ;
+    }
+
+    history.close();
+    qDeleteAll(batteries);
+
+    qStdOut() << "Recorded " << count << " samples to " << Paths::getHistoryFile() << "\n";
+    return 0;
+}
+
+int exportMetrics(int argc, char **argv)
+{
+    QList<Battery *> batteries;
+    QString directory;
+    QByteArray metrics;
+    struct timespec next;
+    time_t lastScan;
+    int interval = EXPORTER_INTERVAL;
+
+    for (int i = 2; i < argc; i++) {
+        QString option = QString(argv[i]);
+        bool ok = i + 1 < argc;
+        if (ok && option == "--textfile")
+            directory = QString::fromLocal8Bit(argv[++i]);
+        else if (ok && option == "--interval")
+            interval = QString(argv[++i]).toInt(&ok);
+        else
+            ok = false;
+        if (!ok || interval <= 0) {
+            qStdOut() << "Invalid export option: " << option << ", see --help\n";
+            return 1;
+        }
+    }
+
+    if (directory.isEmpty()) {
+        qStdOut() << "Missing --textfile (directory), see --help\n";
+        return 1;
+    }
+
+    Exporter exporter(directory);
+
+    recording = 1;
+    signal(SIGINT, stopRecording);
+    signal(SIGTERM, stopRecording);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    lastScan = next.tv_sec;
+
+    /* The same Battery, and so the same open sampler, for every round */
+    while (recording) {
+        if (!sameBatteries(batteries)) {
+            qDeleteAll(batteries);
+            batteries.clear();
+            for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+                batteries.append(new Battery());
+                batteries.last()->name = supply.name;
+            }
+        }
+
+        for (Battery *battery : batteries)
+            battery->readBattery(battery->name);
+
+        /* Logged by the exporter; a full disk or a busy directory may clear up, try again next round */
+        Exporter::render(batteries, &metrics);
+        exporter.write(metrics);
+
+        if (next.tv_sec - lastScan >= HISTORY_SYNC_INTERVAL) {
+            Registry::getRegistry()->scan();
+            lastScan = next.tv_sec;
+        }
+
+        next.tv_sec += interval;
+        while (recording && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR)
+            ;
+    }
+
+    qDeleteAll(batteries);
+
+    qStdOut() << "Wrote " << exporter.getFile() << " " << exporter.getWrites() << " times\n";
+    return 0;
+}
+
+enum WatchFormat {
+    WatchText, WatchJson, WatchI3bar, WatchWaybar
+};
+
+/* "BAT0 87% Discharging 2:10 h", what a status bar has room for */
+static QString barText(const Battery *battery)
+{
+    QString text = QString("%1 %2% %3").arg(battery->name, QString::number(battery->capacity), battery->status);
+    int remaining = battery->time_to_empty >= 0 ? battery->time_to_empty : battery->time_to_full;
+    if (remaining >= 0)
+        text += " " + Estimator::formatTime(remaining);
+    return text;
+}
+
+static void appendBar(WatchFormat format, const QList<Battery *> &batteries, QByteArray *output)
+{
+    if (format == WatchI3bar) {
+        output->append('[');
+        for (int i = 0; i < batteries.size(); i++) {
+            bool urgent = batteries[i]->capacity < 10 && batteries[i]->time_to_empty >= 0;
+            output->append(i == 0 ? "{\"name\":\"batteryctl\",\"instance\":" : ",{\"name\":\"batteryctl\",\"instance\":");
+            Serializer::appendJsonString(batteries[i]->name.toUtf8(), output);
+            output->append(",\"full_text\":");
+            Serializer::appendJsonString(barText(batteries[i]).toUtf8(), output);
+            output->append(urgent ? ",\"urgent\":true}" : "}");
+        }
+        output->append("],\n");
+        return;
+    }
+
+    QStringList texts;
+    QStringList tooltips;
+    int percentage = 0;
+
+    for (const Battery *battery : batteries) {
+        texts << QString::number(battery->capacity) + "%";
+        tooltips << barText(battery);
+        percentage += battery->capacity;
+    }
+    if (!batteries.isEmpty())
+        percentage /= batteries.size();
+
+    output->append("{\"text\":");
+    Serializer::appendJsonString(texts.join(" ").toUtf8(), output);
+    output->append(",\"tooltip\":");
+    Serializer::appendJsonString(tooltips.join("\n").toUtf8(), output);
+    output->append(",\"class\":");
+    Serializer::appendJsonString(batteries.isEmpty() ? QByteArray() : batteries.first()->status.toLower().toUtf8(), output);
+    output->append(",\"percentage\":" + QByteArray::number(percentage) + "}\n");
+}
+
+static void appendChanges(const Battery &battery, const Battery &previous, const bool *changed, bool first,
+                          QByteArray *output)
+{
+    char stamp[16];
+    time_t now = time(nullptr);
+    struct tm local;
+
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &local);
+
+    for (int i = 0; i < Attributes::count; i++) {
+        if (!changed[i])
+            continue;
+        const char *label = Attributes::table[i].label;
+        QString line = QString("%1 %2 %3: ").arg(stamp, battery.name, label != nullptr ? label : Attributes::table[i].name);
+        if (!first)
+            line += Attributes::format(previous, i) + " -> ";
+        output->append((line + Attributes::format(battery, i) + "\n").toUtf8());
+    }
+}
+
+int watchBatteries(int argc, char **argv)
+{
+    QList<Battery *> batteries;
+    QList<Battery *> previous;
+    WatchFormat format = WatchText;
+    QByteArray output;
+    QByteArray bar;
+    QByteArray lastBar;
+    bool changed[Attributes::count];
+    bool first = true;
+    struct timespec next;
+    time_t lastScan;
+    int interval = 1;
+
+    for (int i = 2; i < argc; i++) {
+        QString option = QString(argv[i]);
+        QString value;
+        int equals = option.indexOf("=");
+        if (equals > 0) {
+            value = option.mid(equals + 1);
+            option = option.left(equals);
+        } else if (i + 1 < argc) {
+            value = QString(argv[++i]);
+        }
+
+        bool ok = true;
+        if (option == "--interval")
+            interval = value.toInt(&ok);
+        else if (option == "--format" && value == "text")
+            format = WatchText;
+        else if (option == "--format" && value == "json")
+            format = WatchJson;
+        else if (option == "--format" && value == "i3bar")
+            format = WatchI3bar;
+        else if (option == "--format" && value == "waybar")
+            format = WatchWaybar;
+        else
+            ok = false;
+        if (!ok || interval <= 0) {
+            qStdOut() << "Invalid watch option: " << option << ", see --help\n";
+            return 1;
+        }
+    }
+
+    if (format == WatchI3bar) {
+        fputs("{\"version\":1}\n[\n", stdout);
+        fflush(stdout);
+    }
+
+    recording = 1;
+    signal(SIGINT, stopRecording);
+    signal(SIGTERM, stopRecording);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    lastScan = next.tv_sec;
+
+    /* One sampler per battery for the whole session, each round is diffed against the last */
+    while (recording) {
+        if (!sameBatteries(batteries)) {
+            qDeleteAll(batteries);
+            qDeleteAll(previous);
+            batteries.clear();
+            previous.clear();
+            for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+                batteries.append(new Battery());
+                batteries.last()->name = supply.name;
+                previous.append(new Battery());
+            }
+            first = true;
+        }
+
+        output.clear();
+
+        for (int i = 0; i < batteries.size(); i++) {
+            Battery *battery = batteries[i];
+            int count = 0;
+
+            battery->readBattery(battery->name);
+
+            for (int j = 0; j < Attributes::count; j++) {
+                changed[j] = first || !Attributes::equals(*battery, *previous[i], j);
+                if (changed[j])
+                    count++;
+            }
+
+            if (count == 0)
+                continue;
+
+            if (format == WatchText) {
+                appendChanges(*battery, *previous[i], changed, first, &output);
+            } else if (format == WatchJson) {
+                Serializer serializer(Serializer::Format::JsonLines, &output);
+                serializer.add(*battery, battery->name, changed);
+            }
+
+            for (int j = 0; j < Attributes::count; j++)
+                if (changed[j])
+                    Attributes::copy(previous[i], *battery, j);
+        }
+
+        /* Bars always get the whole line, but only when it reads differently */
+        if (format == WatchI3bar || format == WatchWaybar) {
+            bar.clear();
+            appendBar(format, batteries, &bar);
+            if (bar != lastBar) {
+                output.append(bar);
+                lastBar = bar;
+            }
+        }
+
+        if (!output.isEmpty()) {
+            fwrite(output.constData(), 1, output.size(), stdout);
+            fflush(stdout);
+        }
+
+        if (next.tv_sec - lastScan >= HISTORY_SYNC_INTERVAL) {
+            Registry::getRegistry()->scan();
+            lastScan = next.tv_sec;
+        }
+
+        first = false;
+        next.tv_sec += interval;
+        while (recording && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR)
+            ;
+    }
+
+    qDeleteAll(batteries);
+    qDeleteAll(previous);
+    return 0;
+}
+
+int archiveHistory(QString file)
+{
+    History history(Paths::getHistoryFile());
+    ArchiveWriter writer(file);
+
+    if (!history.open(History::Mode::ReadOnly)) {
+        qStdOut() << "Could not open the history file " << Paths::getHistoryFile() << "\n";
+        return 1;
+    }
+
+    if (!writer.open()) {
+        qStdOut() << "Could not create " << file << "\n";
+        return 1;
+    }
+
+    for (uint64_t i = history.getTail(); i < history.getHead(); i++) {
+        const HistoryRecord *record = history.at(i);
+        if (record != nullptr)
+            writer.append(*record, history.getBatteryName(record->battery));
+    }
+
+    if (!writer.finish()) {
+        qStdOut() << "Could not write " << file << "\n";
+        return 1;
+    }
+
+    qStdOut() << QString("Archived %1 samples in %2 blocks, %3 bytes (%4 bytes per sample)\n").arg(
+                     QString::number(writer.getSamples()),
+                     QString::number(writer.getBlocks()),
+                     QString::number(writer.getBytes()),
+                     QString::number(writer.getSamples() == 0 ? 0.0 : (double) writer.getBytes() / writer.getSamples()));
+    return 0;
+}
+
+static bool parseDuration(const QString &value, int64_t *duration)
+{
+    static const struct {
+        char unit;
+        int64_t scale;
+    } units[] = { { 's', 1000 }, { 'm', 60 * 1000 }, { 'h', 3600 * 1000 }, { 'd', 86400 * 1000 } };
+    QString number = value;
+    int64_t scale = 1000;
+    bool ok;
+
+    for (const auto &unit : units) {
+        if (value.endsWith(QChar(unit.unit))) {
+            number = value.left(value.size() - 1);
+            scale = unit.scale;
+        }
+    }
+
+    int64_t count = number.toLongLong(&ok);
+    if (!ok || count <= 0)
+        return false;
+    *duration = count * scale;
+    return true;
+}
+
+/* Seconds since the epoch, an ISO 8601 date or a duration back from now like -2h */
+static bool parseTime(const QString &value, int64_t *time)
+{
+    bool ok;
+
+    if (value.startsWith("-")) {
+        int64_t ago;
+        if (!parseDuration(value.mid(1), &ago))
+            return false;
+        *time = QDateTime::currentMSecsSinceEpoch() - ago;
+        return true;
+    }
+
+    int64_t seconds = value.toLongLong(&ok);
+    if (ok) {
+        *time = seconds * 1000;
+        return true;
+    }
+
+    QDateTime date = QDateTime::fromString(value, Qt::ISODate);
+    if (!date.isValid())
+        return false;
+    *time = date.toMSecsSinceEpoch();
+    return true;
+}
+
+int printHistory(int argc, char **argv)
+{
+    QStringList archives;
+    QString battery;
+    QString field = "power_now";
+    int64_t since = INT64_MIN;
+    int64_t until = INT64_MAX;
+    int64_t bucket = 5 * 60 * 1000;
+
+    for (int i = 2; i < argc; i++) {
+        QString option(argv[i]);
+        if (i + 1 >= argc) {
+            qStdOut() << "Missing value for " << option << ", see --help\n";
+            return 1;
+        }
+        QString value = QString::fromLocal8Bit(argv[++i]);
+        bool ok = true;
+
+        if (option == "--since")
+            ok = parseTime(value, &since);
+        else if (option == "--until")
+            ok = parseTime(value, &until);
+        else if (option == "--bucket")
+            ok = parseDuration(value, &bucket);
+        else if (option == "--field")
+            field = value;
+        else if (option == "--battery")
+            battery = Battery::nameFromStringConsole(value);
+        else if (option == "--archive")
+            archives.append(value);
+        else
+            ok = false;
+
+        if (!ok) {
+            qStdOut() << "Invalid option: " << option << " " << value << ", see --help\n";
+            return 1;
+        }
+    }
+
+    int column = Archive::columnFromName(field);
+    if (column < 0 || column == Archive::Column::Timestamp) {
+        qStdOut() << "Unknown field: " << field << "\n";
+        return 1;
+    }
+
+    HistoryQuery query((Archive::Column) column, bucket);
+    query.setRange(since, until);
+    query.setBattery(battery);
+
+    if (archives.isEmpty()) {
+        History history(Paths::getHistoryFile());
+        if (!history.open(History::Mode::ReadOnly)) {
+            qStdOut() << "Could not open the history file " << Paths::getHistoryFile() << "\n";
+            return 1;
+        }
+        query.scan(history);
+    }
+
+    for (const QString &file : archives) {
+        ArchiveReader archive(file);
+        if (!archive.open() || !query.scan(&archive)) {
+            qStdOut() << "Could not read the archive " << file << "\n";
+            return 1;
+        }
+    }
+
+    const QMap<QString, QMap<int64_t, HistoryBucket> > &results = query.getResults();
+    for (QMap<QString, QMap<int64_t, HistoryBucket> >::const_iterator b = results.begin(); b != results.end(); ++b) {
+        qStdOut() << b.key() << " - " << field << "\n";
+        qStdOut() << "Start\t\t\tSamples\tMinimum\tMaximum\tMean\tLast\n";
+        for (QMap<int64_t, HistoryBucket>::const_iterator i = b.value().begin(); i != b.value().end(); ++i) {
+            const HistoryBucket &data = i.value();
+            qStdOut() << QString("%1\t%2\t%3\t%4\t%5\t%6\n").arg(
+                             QDateTime::fromMSecsSinceEpoch(i.key()).toString("yyyy-MM-dd HH:mm:ss"),
+                             QString::number(data.count),
+                             QString::number(data.minimum),
+                             QString::number(data.maximum),
+                             QString::number(data.sum / data.count),
+                             QString::number(data.last));
+        }
+        qStdOut() << "\n";
+    }
+
+    return 0;
+}
+
+int printFade()
+{
+    FadeModel *model = FadeModel::getFadeModel();
+    QList<int> thresholds = Storage::getStorage()->getReplacementThresholds();
+
+    if (!model->load() || model->getSerials().isEmpty()) {
+        qStdOut() << "No capacity history in " << Paths::getFadeFile() << ", is batteryctld running?\n";
+        return 1;
+    }
+
+    for (const QString &serial : model->getSerials()) {
+        const FadeModel::State *state = model->find(serial);
+        double design = state->energy_full_design;
+        double intercept;
+        double slope;
+
+        qStdOut() << serial << " (" << state->name << ") - " << QString::number(state->cycles.n) << " points\n";
+        qStdOut() << QString("Full charge capacity:\t\t%1 Wh (%2 % of design)\n").arg(
+                         QString::number(state->energy_full / 1000000.0f),
+                         QString::number(qRound(state->energy_full / design * 100)));
+
+        if (state->cycles.solve(&intercept, &slope))
+            qStdOut() << "Fade per 100 cycles:\t\t" << QString::number(slope * 100 / design * 100, 'f', 2) << " %\n";
+        if (state->days.solve(&intercept, &slope))
+            qStdOut() << "Fade per year:\t\t\t" << QString::number(slope * 365 / design * 100, 'f', 2) << " %\n";
+
+        for (int threshold : thresholds) {
+            double cycle;
+            double day;
+            QString when = "-";
+            QString at = "-";
+
+            if (state->cycles.project(design * threshold / 100, &cycle))
+                at = "cycle " + QString::number(qMax(0, qRound(cycle)));
+            if (state->days.project(design * threshold / 100, &day))
+                when = QDateTime::fromMSecsSinceEpoch(state->origin + (int64_t) (day * FADE_DAY)).toString("yyyy-MM-dd");
+
+            qStdOut() << QString("Below %1 %:\t\t\t%2, %3\n").arg(QString::number(threshold), at, when);
+        }
+        qStdOut() << "\n";
+    }
+
+    return 0;
+}
+
+static QString formatLatency(uint64_t ns)
+{
+    if (ns < 10000)
+        return QString::number(ns) + " ns";
+    if (ns < 10000000)
+        return QString::number(ns / 1000) + " us";
+    return QString::number(ns / 1000000) + " ms";
+}
+
+int profileBatteries(int argc, char **argv)
+{
+    QString battery;
+    int iterations = PROFILER_ITERATIONS;
+    uint64_t outlier = PROFILER_OUTLIER;
+
+    for (int i = 2; i < argc; i++) {
+        QString option(argv[i]);
+        if (i + 1 >= argc) {
+            qStdOut() << "Missing value for " << option << ", see --help\n";
+            return 1;
+        }
+        QString value = QString::fromLocal8Bit(argv[++i]);
+        bool ok = true;
+
+        if (option == "--iterations")
+            iterations = value.toInt(&ok);
+        else if (option == "--battery")
+            battery = Battery::nameFromStringConsole(value);
+        else if (option == "--outlier")
+            outlier = value.toInt(&ok) * 1000ULL;
+        else
+            ok = false;
+
+        if (!ok || iterations <= 0) {
+            qStdOut() << "Invalid option: " << option << " " << value << ", see --help\n";
+            return 1;
+        }
+    }
+
+    int profiled = 0;
+    for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+        if (!battery.isEmpty() && supply.name != battery)
+            continue;
+
+        Profiler profiler(supply.name);
+        if (!profiler.open())
+            continue;
+        profiler.run(iterations, outlier);
+        profiled++;
+
+        /* Slowest first, that is where a refresh spends its time */
+        QVector<const Profiler::Probe *> probes;
+        for (const Profiler::Probe &probe : profiler.getProbes())
+            probes.append(&probe);
+        std::sort(probes.begin(), probes.end(), [](const Profiler::Probe *a, const Profiler::Probe *b) {
+            return a->histogram.percentile(0.99) > b->histogram.percentile(0.99);
+        });
+
+        qStdOut() << supply.label() << " - " << QString::number(iterations) << " reads per attribute\n";
+        qStdOut() << QString("%1%2%3%4%5%6\n").arg(QString("Attribute").leftJustified(34),
+                                                 QString("p50").rightJustified(10),
+                                                 QString("p99").rightJustified(10),
+                                                 QString("max").rightJustified(10),
+                                                 QString("Outliers").rightJustified(10),
+                                                 QString("Failed").rightJustified(10));
+        for (const Profiler::Probe *probe : probes)
+            qStdOut() << QString("%1%2%3%4%5%6\n").arg(probe->label.leftJustified(34),
+                                                     formatLatency(probe->histogram.percentile(0.5)).rightJustified(10),
+                                                     formatLatency(probe->histogram.percentile(0.99)).rightJustified(10),
+                                                     formatLatency(probe->histogram.getMax()).rightJustified(10),
+                                                     QString::number(probe->outliers).rightJustified(10),
+                                                     QString::number(probe->failures).rightJustified(10));
+        qStdOut() << "\n";
+    }
+
+    if (profiled == 0) {
+        qStdOut() << "No battery to profile\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+int runHelper()
+{
+    char line[PROTOCOL_MAX_REQUEST];
+
+    /* Serves the GUI over the pipes pkexec hands us until it goes away */
+    while (fgets(line, sizeof(line), stdin) != nullptr) {
+        QByteArray response = Protocol::execute(QByteArray(line).simplified().split(' '));
+        fwrite(response.constData(), 1, response.size(), stdout);
+        fflush(stdout);
+    }
+
+    return 0;
+}
+
+int launchGui(char **argv)
+{
+    char self[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    QByteArray gui = GUI_BINARY;
+
+    /* Prefer the GUI installed next to us, the PATH one otherwise */
+    if (length > 0) {
+        self[length] = '\0';
+        QByteArray sibling = QByteArray(self).left(QByteArray(self).lastIndexOf('/') + 1) + GUI_BINARY;
+        if (access(sibling.constData(), X_OK) == 0)
+            gui = sibling;
+    }
+
+    Paths::exportEnvironment();
+    argv[1] = gui.data();
+    execvp(gui.constData(), argv + 1);
+
+    qStdOut() << QString("Cannot start %1: %2\n").arg(GUI_BINARY).arg(strerror(errno));
+    return 1;
+}
+
+int runConsole(int argc, char **argv)
+{
+    QString command(argv[1]);
+
+    if (command == "--help") {
+        printHelp();
+        return 0;
+    }
+
+    if (command == "--version") {
+        printVersion();
+        return 0;
+    }
+
+    if (command == "info") {
+        Serializer::Format format = Serializer::Format::Text;
+        for (int i = 2; i < argc; i++) {
+            QString option = QString(argv[i]);
+            bool ok = true;
+            if (option == "--json")
+                format = Serializer::Format::Json;
+            else if (option.startsWith("--format="))
+                ok = Serializer::parseFormat(option.mid(9), &format);
+            else if (option == "--format" && i + 1 < argc)
+                ok = Serializer::parseFormat(QString(argv[++i]), &format);
+            else
+                ok = false;
+            if (!ok) {
+                qStdOut() << "Invalid info option: " << option << ", see --help\n";
+                return 1;
+            }
+        }
+
+        QByteArray payload;
+        int ret = forward("INFO", &payload);
+        if (ret > 0)
+            return ret;
+        if (ret == 0)
+            printBatteries(payload, format);
+        else
+            printBatteries(format);
+        return 0;
+    }
+
+    if (command == "set") {
+        if (argc < 5) {
+            qStdOut() << "Not enough arguments, see --help\n";
+            return 11;
+        }
+        return setThreshold(QString(argv[2]), QString(argv[3]), QString(argv[4]));
+    }
+
+    if (command == "preset") {
+        if (argc < 4) {
+            qStdOut() << "Not enough arguments, see --help\n";
+            return 1;
+        }
+        return setPreset(QString(argv[3]), QString(argv[2]));
+    }
+
+    if (command == "restore") {
+        bool ok = true;
+        int seconds = argc > 2 ? QString(argv[2]).toInt(&ok) : RESTORE_DEADLINE / 1000;
+        if (!ok || seconds <= 0 || seconds > RESTORE_MAX_DEADLINE / 1000) {
+            qStdOut() << "Invalid deadline: " << argv[2] << ", at most " << RESTORE_MAX_DEADLINE / 1000 << " seconds\n";
+            return 1;
+        }
+        return restoreSettings(seconds * 1000);
+    }
+
+    if (command == "record") {
+        return recordHistory(argc > 2 ? QString(argv[2]) : QString());
+    }
+
+    if (command == "archive") {
+        if (argc < 3) {
+            qStdOut() << "Not enough arguments, see --help\n";
+            return 1;
+        }
+        return archiveHistory(QString::fromLocal8Bit(argv[2]));
+    }
+
+    if (command == "history") {
+        return printHistory(argc, argv);
+    }
+
+    if (command == "watch") {
+        return watchBatteries(argc, argv);
+    }
+
+    if (command == "export") {
+        return exportMetrics(argc, argv);
+    }
+
+    if (command == "profile") {
+        return profileBatteries(argc, argv);
+    }
+
+    if (command == "fade") {
+        return printFade();
+    }
+
+    if (command == "helper") {
+        return runHelper();
+    }
+
+    if (command == "gui") {
+        return launchGui(argv);
+    }
+
+    qStdOut() << QString("Unknown command: %1, see --help.\n").arg(command);
+    return 1;
+}
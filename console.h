@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QTextStream>
+
+#include "core/control.h"
+#include "core/serializer.h"
+
+class Battery;
+
+QTextStream& qStdOut();
+
+void printVersion();
+void printHelp();
+void printBatteryInfo(Battery *bat);
+void printBatteries(Serializer::Format format = Serializer::Format::Text);
+void printBatteries(const QByteArray &payload, Serializer::Format format = Serializer::Format::Text);
+
+int setThreshold(QString what, QString where, QString value_raw);
+int setPreset(QString which, QString where);
+int restoreSettings(int deadline = RESTORE_DEADLINE);
+int recordHistory(QString interval_raw);
+int watchBatteries(int argc, char **argv);
+int exportMetrics(int argc, char **argv);
+int archiveHistory(QString file);
+int printHistory(int argc, char **argv);
+int printFade();
+int profileBatteries(int argc, char **argv);
+int runHelper();
+int launchGui(char **argv);
+int runConsole(int argc, char **argv);
+
+#endif // CONSOLE_H
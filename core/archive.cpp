@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "archive.h"
+
+#include <QDebug>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define ARCHIVE_HEADER_SIZE 16
+
+static_assert(Archive::Column::ColumnCount == ARCHIVE_COLUMNS, "The block header has a slot per column");
+
+/* Timestamps step at a steady rate, everything else drifts slowly */
+static const int columnOrder[ARCHIVE_COLUMNS] = { 2, 1, 1, 1, 1, 1, 1, 1 };
+
+static inline uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static inline void putVarint(uint64_t value, QByteArray *output)
+{
+    char buffer[10];
+    int length = 0;
+
+    while (value >= 0x80) {
+        buffer[length++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (char) value;
+    output->append(buffer, length);
+}
+
+static inline const char *getVarint(const char *data, const char *end, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (int shift = 0; data < end && shift < 64; shift += 7) {
+        uint8_t byte = *data++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return data;
+        }
+    }
+
+    return nullptr;
+}
+
+const char *Archive::columnName(Archive::Column column)
+{
+    switch (column) {
+    case Timestamp: return "timestamp";
+    case Capacity: return "capacity";
+    case EnergyNow: return "energy_now";
+    case PowerNow: return "power_now";
+    case VoltageNow: return "voltage_now";
+    case Status: return "status";
+    case ChargeStartThreshold: return "charge_start_threshold";
+    case ChargeStopThreshold: return "charge_stop_threshold";
+    default: return "";
+    }
+}
+
+int Archive::columnFromName(const QString &name)
+{
+    for (int i = 0; i < ColumnCount; i++)
+        if (name == QLatin1String(columnName((Archive::Column) i)))
+            return i;
+    return -1;
+}
+
+/*
+ * A zero residual is written as 0 followed by the number of further
+ * zeros, any other residual as its zigzag varint.
+ */
+void Archive::encodeColumn(const int64_t *values, int count, int order, QByteArray *output)
+{
+    int64_t previous = 0;
+    int64_t delta = 0;
+    uint64_t zeros = 0;
+
+    for (int i = 0; i < count; i++) {
+        int64_t residual = values[i] - previous;
+        if (order == 2) {
+            int64_t next = residual;
+            residual -= delta;
+            delta = next;
+        }
+        previous = values[i];
+
+        if (residual == 0) {
+            zeros++;
+            continue;
+        }
+        if (zeros > 0) {
+            putVarint(0, output);
+            putVarint(zeros - 1, output);
+            zeros = 0;
+        }
+        putVarint(zigzag(residual), output);
+    }
+
+    if (zeros > 0) {
+        putVarint(0, output);
+        putVarint(zeros - 1, output);
+    }
+}
+
+bool Archive::decodeColumn(const char *data, int length, int count, int order, int64_t *values)
+{
+    const char *end = data + length;
+    int64_t previous = 0;
+    int64_t delta = 0;
+    uint64_t token;
+    int i = 0;
+
+    while (i < count) {
+        data = getVarint(data, end, &token);
+        if (data == nullptr)
+            return false;
+
+        if (token != 0) {
+            int64_t residual = unzigzag(token);
+            if (order == 2) {
+                delta += residual;
+                residual = delta;
+            }
+            previous += residual;
+            values[i++] = previous;
+            continue;
+        }
+
+        data = getVarint(data, end, &token);
+        if (data == nullptr || token >= (uint64_t) (count - i))
+            return false;
+
+        /* A run of unchanged residuals keeps the current step */
+        int64_t step = order == 2 ? delta : 0;
+        for (int run = (int) token + 1; run > 0; run--) {
+            previous += step;
+            values[i++] = previous;
+        }
+    }
+
+    return data == end;
+}
+
+ArchiveWriter::ArchiveWriter(const QString &file) :
+    file(file), output(nullptr), offset(0), samples(0)
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    if (output != nullptr)
+        fclose(output);
+}
+
+bool ArchiveWriter::open()
+{
+    char header[ARCHIVE_HEADER_SIZE];
+    uint32_t version = ARCHIVE_VERSION;
+    uint32_t columns = ARCHIVE_COLUMNS;
+
+    output = fopen(file.toLocal8Bit().constData(), "wb");
+    if (output == nullptr) {
+        qDebug() << "Could not create" << file << ":" << strerror(errno);
+        return false;
+    }
+
+    memcpy(header, ARCHIVE_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &columns, sizeof(columns));
+    return write(header, sizeof(header));
+}
+
+int ArchiveWriter::findBattery(const QString &name)
+{
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++) {
+        if (names[i].isEmpty())
+            names[i] = name;
+        if (names[i] == name)
+            return i;
+    }
+    return -1;
+}
+
+bool ArchiveWriter::append(const HistoryRecord &record, const QString &name)
+{
+    int battery = findBattery(name);
+    if (battery < 0 || output == nullptr)
+        return false;
+
+    QVector<int64_t> *columns = pending[battery];
+    columns[Archive::Column::Timestamp].append(record.timestamp);
+    columns[Archive::Column::Capacity].append(record.capacity);
+    columns[Archive::Column::EnergyNow].append(record.energy_now);
+    columns[Archive::Column::PowerNow].append(record.power_now);
+    columns[Archive::Column::VoltageNow].append(record.voltage_now);
+    columns[Archive::Column::Status].append(record.status);
+    columns[Archive::Column::ChargeStartThreshold].append(record.charge_start_threshold);
+    columns[Archive::Column::ChargeStopThreshold].append(record.charge_stop_threshold);
+    samples++;
+
+    if (columns[Archive::Column::Timestamp].size() >= ARCHIVE_BLOCK_SAMPLES)
+        return flush(battery);
+    return true;
+}
+
+bool ArchiveWriter::flush(int battery)
+{
+    QVector<int64_t> *columns = pending[battery];
+    int count = columns[Archive::Column::Timestamp].size();
+    ArchiveBlockHeader header;
+    ArchiveIndexEntry entry;
+
+    if (count == 0)
+        return true;
+
+    memset(&header, 0, sizeof(header));
+    header.count = count;
+    header.battery = battery;
+    encoded.clear();
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        const int64_t *values = columns[c].constData();
+        int64_t minimum = values[0];
+        int64_t maximum = values[0];
+        for (int i = 1; i < count; i++) {
+            minimum = values[i] < minimum ? values[i] : minimum;
+            maximum = values[i] > maximum ? values[i] : maximum;
+        }
+        header.minimum[c] = minimum;
+        header.maximum[c] = maximum;
+
+        int before = encoded.size();
+        Archive::encodeColumn(values, count, columnOrder[c], &encoded);
+        header.length[c] = encoded.size() - before;
+        columns[c].resize(0);
+    }
+
+    entry.offset = offset;
+    entry.first = header.minimum[Archive::Column::Timestamp];
+    entry.last = header.maximum[Archive::Column::Timestamp];
+    entry.count = count;
+    entry.battery = battery;
+    index.append(entry);
+
+    return write(&header, sizeof(header)) && write(encoded.constData(), encoded.size());
+}
+
+bool ArchiveWriter::finish()
+{
+    ArchiveFooter footer;
+    bool ok = true;
+
+    if (output == nullptr)
+        return false;
+
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++)
+        ok = ok && flush(i);
+
+    memset(&footer, 0, sizeof(footer));
+    footer.index = offset;
+    footer.blocks = index.size();
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++) {
+        QByteArray name = names[i].toLatin1().left(HISTORY_NAME_SIZE - 1);
+        memcpy(footer.names[i], name.constData(), name.size());
+    }
+    memcpy(footer.magic, ARCHIVE_MAGIC, sizeof(footer.magic));
+
+    ok = ok && write(index.constData(), index.size() * sizeof(ArchiveIndexEntry));
+    ok = ok && write(&footer, sizeof(footer));
+    ok = fclose(output) == 0 && ok;
+    output = nullptr;
+
+    if (!ok)
+        qDebug() << "Could not write" << file << ":" << strerror(errno);
+    return ok;
+}
+
+bool ArchiveWriter::write(const void *data, size_t length)
+{
+    if (length > 0 && fwrite(data, length, 1, output) != 1)
+        return false;
+    offset += length;
+    return true;
+}
+
+uint64_t ArchiveWriter::getSamples() const
+{
+    return samples;
+}
+
+uint64_t ArchiveWriter::getBlocks() const
+{
+    return index.size();
+}
+
+uint64_t ArchiveWriter::getBytes() const
+{
+    return offset;
+}
+
+ArchiveReader::ArchiveReader(const QString &file) :
+    file(file), fd(-1), end(0)
+{
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    close();
+}
+
+bool ArchiveReader::open()
+{
+    struct stat info;
+    ArchiveFooter footer;
+    char header[ARCHIVE_HEADER_SIZE];
+
+    close();
+
+    fd = ::open(file.toLocal8Bit().constData(), O_RDONLY);
+    if (fd < 0) {
+        qDebug() << "Could not open" << file << ":" << strerror(errno);
+        return false;
+    }
+
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t) (ARCHIVE_HEADER_SIZE + sizeof(footer))
+            || pread(fd, header, sizeof(header), 0) != sizeof(header)
+            || pread(fd, &footer, sizeof(footer), info.st_size - sizeof(footer)) != sizeof(footer)
+            || memcmp(header, ARCHIVE_MAGIC, 8) != 0
+            || memcmp(footer.magic, ARCHIVE_MAGIC, sizeof(footer.magic)) != 0
+            /* Bound the untrusted count before any arithmetic on it can wrap */
+            || footer.blocks > (info.st_size - sizeof(footer)) / sizeof(ArchiveIndexEntry)
+            || footer.index > info.st_size - sizeof(footer) - footer.blocks * sizeof(ArchiveIndexEntry)
+            || footer.index + footer.blocks * sizeof(ArchiveIndexEntry) + sizeof(footer) != (uint64_t) info.st_size) {
+        qDebug() << file << "is not an archive";
+        close();
+        return false;
+    }
+
+    end = footer.index;
+    index.resize(footer.blocks);
+    ssize_t length = footer.blocks * sizeof(ArchiveIndexEntry);
+    if (pread(fd, index.data(), length, footer.index) != length) {
+        qDebug() << "Could not read the index of" << file;
+        close();
+        return false;
+    }
+
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++)
+        names[i] = QString::fromLatin1(footer.names[i], strnlen(footer.names[i], HISTORY_NAME_SIZE));
+
+    return true;
+}
+
+void ArchiveReader::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    end = 0;
+    index.clear();
+}
+
+int ArchiveReader::getBlockCount() const
+{
+    return index.size();
+}
+
+const ArchiveIndexEntry &ArchiveReader::getEntry(int block) const
+{
+    return index[block];
+}
+
+bool ArchiveReader::readHeader(int block, ArchiveBlockHeader *header)
+{
+    return pread(fd, header, sizeof(*header), index[block].offset) == sizeof(*header);
+}
+
+bool ArchiveReader::readBlock(int block, unsigned columns, ArchiveSamples *samples)
+{
+    ArchiveBlockHeader header;
+    uint64_t length = 0;
+
+    if (!readHeader(block, &header))
+        return false;
+
+    /* The header comes from the file, check it before sizing anything by it */
+    uint64_t next = block + 1 < index.size() ? index[block + 1].offset : end;
+    if (next < index[block].offset + sizeof(header)
+            || header.count != index[block].count || header.count == 0 || header.count > ARCHIVE_BLOCK_SAMPLES
+            || header.battery >= HISTORY_MAX_BATTERIES) {
+        qDebug() << "Corrupted block" << block << "in" << file;
+        return false;
+    }
+    uint64_t size = next - index[block].offset - sizeof(header);
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        length += header.length[c];
+        if (length > size) {
+            qDebug() << "Corrupted block" << block << "in" << file;
+            return false;
+        }
+    }
+
+    data.resize(length);
+    if (pread(fd, data.data(), length, index[block].offset + sizeof(header)) != (ssize_t) length)
+        return false;
+
+    samples->count = header.count;
+    samples->battery = header.battery;
+
+    const char *column = data.constData();
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        if (columns & (1u << c)) {
+            samples->columns[c].resize(header.count);
+            if (!Archive::decodeColumn(column, header.length[c], header.count, columnOrder[c], samples->columns[c].data()))
+                return false;
+        }
+        column += header.length[c];
+    }
+
+    return true;
+}
+
+QString ArchiveReader::getBatteryName(int battery) const
+{
+    if (battery < 0 || battery >= HISTORY_MAX_BATTERIES)
+        return QString();
+    return names[battery];
+}
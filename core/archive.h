@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "history.h"
+
+#define ARCHIVE_MAGIC "BCTLARCH"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_SAMPLES 4096
+#define ARCHIVE_COLUMNS 8
+
+/*
+ * Per-block header, followed by the encoded columns in Archive::Column
+ * order. The minima and maxima let a reader skip a block without
+ * decoding it.
+ */
+struct ArchiveBlockHeader
+{
+    uint32_t count;
+    uint32_t battery;
+    int64_t minimum[ARCHIVE_COLUMNS];
+    int64_t maximum[ARCHIVE_COLUMNS];
+    uint32_t length[ARCHIVE_COLUMNS];
+};
+
+/* Entry of the block index written after the last block */
+struct ArchiveIndexEntry
+{
+    uint64_t offset;
+    int64_t first;
+    int64_t last;
+    uint32_t count;
+    uint32_t battery;
+};
+
+struct ArchiveFooter
+{
+    uint64_t index;
+    uint64_t blocks;
+    char names[HISTORY_MAX_BATTERIES][HISTORY_NAME_SIZE];
+    char magic[8];
+};
+
+/*
+ * Compact long-term storage for history samples. Samples are grouped in
+ * blocks of one battery each, and each column of a block is stored as
+ * zigzag varints of the difference to the previous value, with runs of
+ * unchanged values collapsed. Timestamps are stored as the difference
+ * of the differences, so a steady sampling rate costs nearly nothing.
+ */
+class Archive
+{
+public:
+
+    enum Column {
+        Timestamp,
+        Capacity,
+        EnergyNow,
+        PowerNow,
+        VoltageNow,
+        Status,
+        ChargeStartThreshold,
+        ChargeStopThreshold,
+        ColumnCount
+    };
+
+    static const char *columnName(Archive::Column column);
+    static int columnFromName(const QString &name);
+
+    static void encodeColumn(const int64_t *values, int count, int order, QByteArray *output);
+    static bool decodeColumn(const char *data, int length, int count, int order, int64_t *values);
+};
+
+/* Decoded columns of one block, only the requested ones are filled */
+struct ArchiveSamples
+{
+    int count;
+    int battery;
+    QVector<int64_t> columns[Archive::Column::ColumnCount];
+};
+
+/* Streams samples into an archive, one pending block per battery */
+class ArchiveWriter
+{
+public:
+    explicit ArchiveWriter(const QString &file);
+    ~ArchiveWriter();
+
+    bool open();
+    bool append(const HistoryRecord &record, const QString &name);
+    bool finish();
+
+    uint64_t getSamples() const;
+    uint64_t getBlocks() const;
+    uint64_t getBytes() const;
+
+private:
+    QString file;
+    FILE *output;
+    uint64_t offset;
+    uint64_t samples;
+    QVector<ArchiveIndexEntry> index;
+    uint64_t end;
+    QString names[HISTORY_MAX_BATTERIES];
+    QVector<int64_t> pending[HISTORY_MAX_BATTERIES][Archive::Column::ColumnCount];
+    QByteArray encoded;
+
+    int findBattery(const QString &name);
+    bool flush(int battery);
+    bool write(const void *data, size_t length);
+};
+
+/* Random access to the blocks of an archive through its index */
+class ArchiveReader
+{
+public:
+    explicit ArchiveReader(const QString &file);
+    ~ArchiveReader();
+
+    bool open();
+    void close();
+
+    int getBlockCount() const;
+    const ArchiveIndexEntry &getEntry(int block) const;
+    bool readHeader(int block, ArchiveBlockHeader *header);
+    bool readBlock(int block, unsigned columns, ArchiveSamples *samples);
+    QString getBatteryName(int battery) const;
+
+private:
+    QString file;
+    int fd;
+    QVector<ArchiveIndexEntry> index;
+    uint64_t end;
+    QString names[HISTORY_MAX_BATTERIES];
+    QByteArray data;
+};
+
+#endif // ARCHIVE_H
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "attributes.h"
+#include "estimator.h"
+
+#include <string.h>
+
+constexpr Attribute Attributes::table[];
+
+int Attributes::find(const char *name, int length)
+{
+    for (int i = 0; i < count; i++)
+        if (strncmp(table[i].name, name, length) == 0 && table[i].name[length] == '\0')
+            return i;
+    return -1;
+}
+
+QString Attributes::format(const Battery &battery, int index)
+{
+    const Attribute &attribute = table[index];
+    QString value;
+
+    switch (attribute.type) {
+    case Attribute::Type::Text:
+        return battery.*attribute.text;
+    case Attribute::Type::Duration:
+        return Estimator::formatTime(battery.*attribute.integer);
+    case Attribute::Type::Real:
+        value = QString::number(battery.*attribute.real / attribute.scale);
+        break;
+    case Attribute::Type::Integer:
+        if (attribute.blank && battery.*attribute.integer == 0)
+            return "-";
+        if (attribute.scale == 1)
+            value = QString::number(battery.*attribute.integer);
+        else
+            value = QString::number(battery.*attribute.integer / attribute.scale);
+        break;
+    }
+
+    if (attribute.unit[0] != '\0')
+        value += QString(" ") + attribute.unit;
+    return value;
+}
+
+QByteArray Attributes::encode(const Battery &battery, int index)
+{
+    const Attribute &attribute = table[index];
+
+    switch (attribute.type) {
+    case Attribute::Type::Text:
+        return (battery.*attribute.text).toUtf8();
+    case Attribute::Type::Real:
+        return QByteArray::number(battery.*attribute.real);
+    case Attribute::Type::Integer:
+    case Attribute::Type::Duration:
+        break;
+    }
+
+    return QByteArray::number(battery.*attribute.integer);
+}
+
+void Attributes::decode(Battery *battery, int index, const QByteArray &value)
+{
+    const Attribute &attribute = table[index];
+
+    switch (attribute.type) {
+    case Attribute::Type::Text:
+        battery->*attribute.text = QString::fromUtf8(value);
+        break;
+    case Attribute::Type::Real:
+        battery->*attribute.real = value.toFloat();
+        break;
+    case Attribute::Type::Integer:
+    case Attribute::Type::Duration:
+        battery->*attribute.integer = value.toInt();
+        break;
+    }
+}
+
+bool Attributes::equals(const Battery &a, const Battery &b, int index)
+{
+    const Attribute &attribute = table[index];
+
+    switch (attribute.type) {
+    case Attribute::Type::Text:
+        return a.*attribute.text == b.*attribute.text;
+    case Attribute::Type::Real:
+        return a.*attribute.real == b.*attribute.real;
+    case Attribute::Type::Integer:
+    case Attribute::Type::Duration:
+        break;
+    }
+
+    return a.*attribute.integer == b.*attribute.integer;
+}
+
+void Attributes::copy(Battery *to, const Battery &from, int index)
+{
+    const Attribute &attribute = table[index];
+
+    switch (attribute.type) {
+    case Attribute::Type::Text:
+        to->*attribute.text = from.*attribute.text;
+        break;
+    case Attribute::Type::Real:
+        to->*attribute.real = from.*attribute.real;
+        break;
+    case Attribute::Type::Integer:
+    case Attribute::Type::Duration:
+        to->*attribute.integer = from.*attribute.integer;
+        break;
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ATTRIBUTES_H
+#define ATTRIBUTES_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "battery.h"
+
+/*
+ * One power_supply attribute: where it comes from, which Battery field
+ * holds it and how it is shown. Dynamic attributes are re-read on every
+ * sample, Static ones once per device and Derived ones are computed in
+ * Battery::readBattery instead of being read from sysfs.
+ */
+struct Attribute
+{
+    enum Source {
+        Dynamic, Static, Derived
+    };
+
+    enum Type {
+        Integer, Real, Text, Duration
+    };
+
+    const char *name;       /* sysfs file and serialization key */
+    const char *uevent;     /* Key after POWER_SUPPLY_ in uevent, or nullptr */
+    Source source;
+    Type type;
+    int Battery::*integer;
+    float Battery::*real;
+    QString Battery::*text;
+    float scale;            /* Raw value per displayed unit */
+    const char *unit;
+    const char *label;      /* Shown by "info", nullptr to leave it out */
+    bool blank;             /* Zero means not available and is shown as "-" */
+};
+
+constexpr Attribute integerAttribute(const char *name, const char *uevent, Attribute::Source source,
+                                     int Battery::*field, float scale, const char *unit,
+                                     const char *label, bool blank)
+{
+    return Attribute { name, uevent, source, Attribute::Type::Integer, field, nullptr, nullptr,
+                       scale, unit, label, blank };
+}
+
+constexpr Attribute textAttribute(const char *name, const char *uevent, Attribute::Source source,
+                                  QString Battery::*field, const char *label)
+{
+    return Attribute { name, uevent, source, Attribute::Type::Text, nullptr, nullptr, field,
+                       1, "", label, false };
+}
+
+constexpr bool attributeNameEquals(const char *a, const char *b)
+{
+    return *a == *b && (*a == '\0' || attributeNameEquals(a + 1, b + 1));
+}
+
+/*
+ * Every attribute batteryctl knows about, in the order "info" prints
+ * them. The sampler, the printers and the protocol all walk this table,
+ * so a new attribute needs a Battery field and one line here.
+ */
+class Attributes
+{
+public:
+    static constexpr Attribute table[] = {
+        textAttribute("status", "STATUS", Attribute::Source::Dynamic, &Battery::status, "Status"),
+        integerAttribute("capacity", "CAPACITY", Attribute::Source::Dynamic, &Battery::capacity, 1, "%", "Capacity", false),
+        integerAttribute("energy_now", "ENERGY_NOW", Attribute::Source::Dynamic, &Battery::energy_now, 1000000, "Wh", "Current capacity", true),
+        integerAttribute("energy_full", "ENERGY_FULL", Attribute::Source::Dynamic, &Battery::energy_full, 1000000, "Wh", "Full charge capacity", true),
+        integerAttribute("current_now", nullptr, Attribute::Source::Derived, &Battery::current_now, 1000000, "A", "Current", true),
+        integerAttribute("voltage_now", "VOLTAGE_NOW", Attribute::Source::Dynamic, &Battery::voltage_now, 1000000, "V", "Voltage", true),
+        integerAttribute("power_now", "POWER_NOW", Attribute::Source::Dynamic, &Battery::power_now, 1000000, "W", "Wattage", true),
+        integerAttribute("charge_start_threshold", "CHARGE_CONTROL_START_THRESHOLD", Attribute::Source::Dynamic, &Battery::charge_start_threshold, 1, "%", "Charge start threshold", false),
+        integerAttribute("charge_stop_threshold", "CHARGE_CONTROL_END_THRESHOLD", Attribute::Source::Dynamic, &Battery::charge_stop_threshold, 1, "%", "Charge stop threshold", false),
+        { "time_to_empty", nullptr, Attribute::Source::Derived, Attribute::Type::Duration, &Battery::time_to_empty, nullptr, nullptr, 1, "", "Time to empty", false },
+        { "time_to_full", nullptr, Attribute::Source::Derived, Attribute::Type::Duration, &Battery::time_to_full, nullptr, nullptr, 1, "", "Time to full", false },
+        integerAttribute("cycle_count", "CYCLE_COUNT", Attribute::Source::Dynamic, &Battery::cycle_count, 1, "", nullptr, true),
+        integerAttribute("present", "PRESENT", Attribute::Source::Dynamic, &Battery::present, 1, "", nullptr, false),
+        integerAttribute("energy_full_design", "ENERGY_FULL_DESIGN", Attribute::Source::Static, &Battery::energy_full_design, 1000000, "Wh", nullptr, false),
+        integerAttribute("voltage_min_design", "VOLTAGE_MIN_DESIGN", Attribute::Source::Static, &Battery::voltage_min_design, 1000000, "V", nullptr, false),
+        textAttribute("manufacturer", "MANUFACTURER", Attribute::Source::Static, &Battery::manufacturer, nullptr),
+        textAttribute("model_name", "MODEL_NAME", Attribute::Source::Static, &Battery::model_name, nullptr),
+        textAttribute("serial_number", "SERIAL_NUMBER", Attribute::Source::Static, &Battery::serial_number, nullptr),
+        textAttribute("technology", "TECHNOLOGY", Attribute::Source::Static, &Battery::technology, nullptr),
+        { "health", nullptr, Attribute::Source::Derived, Attribute::Type::Real, nullptr, &Battery::health, nullptr, 1, "%", nullptr, false },
+    };
+
+    static constexpr int count = sizeof(table) / sizeof(table[0]);
+
+    /* Resolved at compile time when name is a literal, -1 if unknown */
+    static constexpr int indexOf(const char *name, int index = 0)
+    {
+        return index == count ? -1
+                              : attributeNameEquals(table[index].name, name) ? index : indexOf(name, index + 1);
+    }
+
+    static int find(const char *name, int length);
+    static QString format(const Battery &battery, int index);
+    static QByteArray encode(const Battery &battery, int index);
+    static void decode(Battery *battery, int index, const QByteArray &value);
+    static bool equals(const Battery &a, const Battery &b, int index);
+    static void copy(Battery *to, const Battery &from, int index);
+};
+
+#endif // ATTRIBUTES_H
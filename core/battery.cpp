@@ -26,8 +26,11 @@
 
 #include "battery.h"
 #include "storage.h"
+#include "sampler.h"
+#include "registry.h"
+#include "paths.h"
+#include "estimator.h"
 
-#include <QFile>
 #include <QDebug>
 
 #include <sys/types.h>
@@ -36,31 +39,46 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <stdlib.h>
+#include <stdio.h>
 
-Battery::Battery()
+Battery::Battery() : sampler(nullptr), estimator(nullptr)
 {
+    health = 0;
+    time_to_empty = -1;
+    time_to_full = -1;
+}
 
+Battery::~Battery()
+{
+    delete sampler;
+    delete estimator;
 }
 
-void Battery::readBattery(Battery::BatteryLocation location)
+void Battery::readBattery(const QString &name)
 {
-    capacity = readFileInt(location, "capacity");
-    energy_now = readFileInt(location, "energy_now");
-    charge_start_threshold = readFileInt(location, "charge_start_threshold");
-    charge_stop_threshold = readFileInt(location, "charge_stop_threshold");
-    cycle_count = readBatteryCycles(location);
-    energy_full = readFileInt(location, "energy_full");
-    energy_full_design = readFileInt(location, "energy_full_design");
-    manufacturer = readFileString(location, "manufacturer");
-    model_name = readFileString(location, "model_name");
-    power_now = readFileInt(location, "power_now");
-    present = readFileInt(location, "present");
-    serial_number = readFileString(location, "serial_number");
-    technology = readFileString(location, "technology");
-    voltage_now = readFileInt(location, "voltage_now");
-    voltage_min_design = readFileInt(location, "voltage_min_design");
-    status = Battery::guessBatteryStatus(this, location);
+    if (sampler != nullptr && sampler->getName() != name) {
+        delete sampler;
+        sampler = nullptr;
+    }
+
+    if (sampler == nullptr) {
+        sampler = new Sampler(name);
+        this->name = name;
+        if (estimator != nullptr)
+            estimator->reset();
+    }
+
+    sampler->sample(this);
+
+    current_now = voltage_now == 0 ? 0 : (int) ((long long) power_now * 1000000 / voltage_now);
 
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (estimator == nullptr)
+        estimator = new Estimator();
+    estimator->update(this, now.tv_sec * 1000LL + now.tv_nsec / 1000000);
 
     if (energy_full_design == 0)
         return;
@@ -68,164 +86,189 @@ void Battery::readBattery(Battery::BatteryLocation location)
     health = (float) energy_full / energy_full_design * 100.0f;
 }
 
-bool Battery::isWearControlSupported(Battery::BatteryLocation location)
+bool Battery::isWearControlSupported(const QString &name)
 {
-    QFile f(getBatteryFolder(location) + QString("charge_start_threshold"));
-    return f.exists();
+    const PowerSupply *supply = Registry::getRegistry()->find(name);
+    return supply != nullptr && supply->wearControl;
 }
 
-bool Battery::isPrimaryAvailable()
+bool Battery::isAvailable(const QString &name)
 {
-    return isAvailable(Battery::BatteryLocation::Primary);
+    return Registry::getRegistry()->find(name) != nullptr;
 }
 
-bool Battery::isSecondaryAvailable()
+bool Battery::setStartThreshold(const QString &name, int value)
 {
-    return isAvailable(Battery::BatteryLocation::Secondary);
-}
-
-bool Battery::isAvailable(Battery::BatteryLocation location)
-{
-    QFile f(getBatteryFolder(location));
-    return f.exists();
+    if (!isWearControlSupported(name)) {
+        qDebug() << "Wear control is not supported. You need Linux 4.17+";
+        errno = ENOTSUP;
+        return false;
+    }
+    if (!setThreshold(name, "charge_start_threshold", value))
+        return false;
+    Storage *storage = Storage::getStorage();
+    storage->setStartThreshold(name, value);
+    storage->setSettingType(name, SETTING_CUSTOM);
+    return true;
 }
 
-void Battery::setStartThreshold(Battery::BatteryLocation location, int value)
+bool Battery::setStopThreshold(const QString &name, int value)
 {
-    if (!isWearControlSupported(location)) {
+    if (!isWearControlSupported(name)) {
         qDebug() << "Wear control is not supported. You need Linux 4.17+";
-        return;
+        errno = ENOTSUP;
+        return false;
     }
-    setThreshold(location, "charge_start_threshold", value);
+    if (!setThreshold(name, "charge_stop_threshold", value))
+        return false;
     Storage *storage = Storage::getStorage();
-    storage->setStartThreshold(location, value);
-    storage->setSettingType(location, SETTING_CUSTOM);
+    storage->setStopThreshold(name, value);
+    storage->setSettingType(name, SETTING_CUSTOM);
+    return true;
 }
 
-void Battery::setStopThreshold(Battery::BatteryLocation location, int value)
+/*
+ * Checks for wear control, moves the thresholds with writeThresholds()
+ * and stores them as the ones to restore.
+ */
+bool Battery::applyThresholds(const QString &name, int start, int stop, int *writes)
 {
-    if (!isWearControlSupported(location)) {
+    *writes = 0;
+
+    if (!isWearControlSupported(name)) {
         qDebug() << "Wear control is not supported. You need Linux 4.17+";
-        return;
+        errno = ENOTSUP;
+        return false;
     }
-    setThreshold(location, "charge_stop_threshold", value);
+
+    if (!writeThresholds(getBatteryFolder(name).toLocal8Bit(), start, stop, writes)) {
+        int error = errno;
+        qDebug() << "Error writing the thresholds of" << name << ":" << strerror(error);
+        errno = error;
+        return false;
+    }
+
     Storage *storage = Storage::getStorage();
-    storage->setStopThreshold(location, value);
-    storage->setSettingType(location, SETTING_CUSTOM);
+    storage->setStartThreshold(name, start);
+    storage->setStopThreshold(name, stop);
+    return true;
 }
 
-void Battery::resetThresholdSettings(Battery::BatteryLocation location)
+static int readThresholdFile(const QByteArray &path)
 {
-    setThreshold(location, "charge_start_threshold", 0);
-    setThreshold(location, "charge_stop_threshold", 100);
+    char data[16];
+    int fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+
+    ssize_t length = read(fd, data, sizeof(data) - 1);
+    close(fd);
+    if (length <= 0)
+        return -1;
+
+    data[length] = '\0';
+    char *end;
+    long value = strtol(data, &end, 10);
+    if (end == data)
+        return -1;
+    return (int) value;
 }
 
-Battery::BatteryLocation Battery::locationFromString(QString location)
+/* On failure errno is left as set by open() or write() */
+static bool writeThresholdFile(const QByteArray &path, int value)
 {
-    if (location == PRIMARY)
-        return Battery::BatteryLocation::Primary;
-    if (location == SECONDARY)
-        return Battery::BatteryLocation::Secondary;
-    qDebug() << "!!!ERROR INVALID RUNTINME VALUE!!!";
-    exit(1);
+    char data[16];
+    int length = snprintf(data, sizeof(data), "%d", value);
+    int fd = open(path.constData(), O_WRONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    if (write(fd, data, length + 1) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    close(fd);
+    return true;
 }
 
-Battery::BatteryLocation Battery::locationFromStringConsole(QString location)
+/*
+ * Moves the thresholds under folder to start/stop with as few writes as
+ * possible; each one can be a slow embedded controller call. The kernel
+ * refuses a start at or above the stop, so when both change, the one
+ * that keeps the pair valid in between goes first. Writes that change
+ * nothing are skipped.
+ *
+ * Only the two sysfs files are touched, no Registry, Storage or Paths,
+ * so this is safe on a thread that may outlive its caller.
+ */
+bool Battery::writeThresholds(const QByteArray &folder, int start, int stop, int *writes)
 {
-    if (location == "primary")
-        return Battery::BatteryLocation::Primary;
-    if (location == "secondary")
-        return Battery::BatteryLocation::Secondary;
-    qDebug() << "!!!ERROR INVALID RUNTINME VALUE!!!";
-    exit(1);
+    QByteArray startFile = folder + "charge_start_threshold";
+    QByteArray stopFile = folder + "charge_stop_threshold";
+    int current_start = readThresholdFile(startFile);
+    int current_stop = readThresholdFile(stopFile);
+
+    *writes = 0;
+
+    auto write = [&](const QByteArray &file, int current, int value) {
+        if (current == value)
+            return true;
+        (*writes)++;
+        return writeThresholdFile(file, value);
+    };
+
+    if (current_start < 0 || current_stop < 0) {
+        /* Nothing to go by, open the range fully first */
+        return write(startFile, -1, 0) && write(stopFile, -1, 100)
+                && write(startFile, 0, start) && write(stopFile, 100, stop);
+    }
+    if (start < current_stop)
+        return write(startFile, current_start, start) && write(stopFile, current_stop, stop);
+    return write(stopFile, current_stop, stop) && write(startFile, current_start, start);
 }
 
-QString Battery::stringFromLocationConsole(Battery::BatteryLocation location)
+QString Battery::nameFromStringConsole(const QString &battery)
 {
-    if (location == Battery::BatteryLocation::Primary)
-        return "primary";
-    if (location == Battery::BatteryLocation::Secondary)
-        return "secondary";
-    qDebug() << "!!!ERROR INVALID RUNTINME VALUE!!!";
-    exit(1);
+    if (battery == "primary")
+        return PRIMARY;
+    if (battery == "secondary")
+        return SECONDARY;
+    return battery;
 }
 
-QString Battery::guessBatteryStatus(Battery *battery, Battery::BatteryLocation location)
+QString Battery::guessBatteryStatus(Battery *battery, const QString &status)
 {
-    QString status = Battery::readFileString(location, "status");
+    static const QString notCharging = QStringLiteral("Not Charging");
     if (battery->capacity >= battery->charge_start_threshold
-            && battery->capacity <= battery->charge_stop_threshold && status == "Unknown")
-        return "Not Charging";
+            && battery->capacity <= battery->charge_stop_threshold && status == QLatin1String("Unknown"))
+        return notCharging;
     else
         return status;
 }
 
-void Battery::setThreshold(Battery::BatteryLocation where, const char *what, int much)
+/* On failure errno is left as set by open() or write() for the caller */
+bool Battery::setThreshold(const QString &where, const char *what, int much)
 {
-    QString base = getBatteryFolder(where) + what;
-    int fd = open(base.toStdString().c_str(), O_WRONLY);
-    if (fd < 0) {
-        qDebug() << "Error opening file for writing: " << strerror(errno);
-        return;
+    if (!writeThresholdFile((getBatteryFolder(where) + what).toLocal8Bit(), much)) {
+        int error = errno;
+        qDebug() << "Error writing"  << what << " (" << much << ") to file: " << strerror(error);
+        errno = error;
+        return false;
     }
-    QString data = QString::number(much);
-    if (write(fd, data.toStdString().c_str(), data.length() + 1) < 0) {
-        qDebug() << "Error writing"  << what << " (" << much << ") to file: " << strerror(errno);
-        return;
-    }
-    close(fd);
+    return true;
 }
 
-QString Battery::readFileString(Battery::BatteryLocation location, QString file)
+QString Battery::getBatteryFolder(const QString &name)
 {
-    QFile data(getBatteryFolder(location) + file);
-    if (!data.exists())
-        return "Not Available";
-    data.open(QIODevice::ReadOnly);
-    QByteArray arr = data.read(1024);
-    data.close();
-    return QString(arr).replace("\n", "");
+    return Paths::getPowerSupplyFolder() + name + "/";
 }
 
-int Battery::readFileInt(Battery::BatteryLocation location, QString file)
+QString Battery::getSmapiFolder(const QString &name)
 {
-    QString ret = readFileString(location, file);
-    if (ret == "Not Available")
-        return 0;
-    return ret.toInt();
+    return Paths::getSmapiFolder() + name + "/";
 }
-
-int Battery::readBatteryCycles(Battery::BatteryLocation location)
-{
-    QString location_str;
-    switch (location) {
-    case Battery::BatteryLocation::Primary:
-        location_str = ("/sys/devices/platform/smapi/BAT0/cycle_count");
-        break;
-    case Battery::BatteryLocation::Secondary:
-        location_str = ("/sys/devices/platform/smapi/BAT1/cycle_count");
-        break;
-    }
-
-    QFile smapi(location_str);
-
-    if (smapi.exists()) {
-        smapi.open(QIODevice::ReadOnly);
-        QByteArray arr = smapi.read(1024);
-        smapi.close();
-        return QString(arr).replace("\n", "").toInt();
-    }
-    return readFileInt(location, "cycle_count");
-}
-
-QString Battery::getBatteryFolder(Battery::BatteryLocation location)
-{
-    switch (location) {
-    case Battery::BatteryLocation::Primary:
-        return "/sys/class/power_supply/BAT0/";
-    case Battery::BatteryLocation::Secondary:
-        return "/sys/class/power_supply/BAT1/";
-    }
-    return "Not Available";
-}
-
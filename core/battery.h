@@ -27,11 +27,19 @@
 #ifndef BATTERY_H
 #define BATTERY_H
 
+#include <QByteArray>
 #include <QObject>
 #include <QString>
 
-#define PRIMARY "1 - Main Battery"
-#define SECONDARY "2 - Seconday Battery"
+/* Console aliases for the first two laptop batteries */
+#define PRIMARY "BAT0"
+#define SECONDARY "BAT1"
+
+/* What a text attribute holds when the kernel does not report it */
+#define NOT_AVAILABLE "Not Available"
+
+class Sampler;
+class Estimator;
 
 class Battery : public QObject
 {
@@ -39,15 +47,13 @@ class Battery : public QObject
 
 public:
 
-    enum BatteryLocation {
-        Primary, Secondary
-    };
-
     enum Condition {
         Good, Poor, Bad
     };
 
     Battery();
+    ~Battery();
+    QString name;
     int capacity;
     int energy_now;
     int charge_start_threshold;
@@ -64,33 +70,36 @@ public:
     QString technology;
     int voltage_now;
     int voltage_min_design;
+    /* Derived from power_now and voltage_now, in uA */
+    int current_now;
     float health;
+    /* Seconds, -1 while there is no estimate */
+    int time_to_empty;
+    int time_to_full;
 
-    void readBattery(Battery::BatteryLocation location);
-    static bool isWearControlSupported(BatteryLocation location);
-
-    static bool isPrimaryAvailable();
-    static bool isSecondaryAvailable();
-    static bool isAvailable(Battery::BatteryLocation location);
+    void readBattery(const QString &name);
+    static bool isWearControlSupported(const QString &name);
+    static bool isAvailable(const QString &name);
 
-    static void setStartThreshold(Battery::BatteryLocation location, int value);
-    static void setStopThreshold(Battery::BatteryLocation location, int value);
+    static bool setStartThreshold(const QString &name, int value);
+    static bool setStopThreshold(const QString &name, int value);
 
-    static void resetThresholdSettings(Battery::BatteryLocation location);
+    static bool applyThresholds(const QString &name, int start, int stop, int *writes);
+    static bool writeThresholds(const QByteArray &folder, int start, int stop, int *writes);
 
-    static Battery::BatteryLocation locationFromString(QString location);
-    static Battery::BatteryLocation locationFromStringConsole(QString location);
+    static QString nameFromStringConsole(const QString &battery);
 
-    static QString stringFromLocationConsole(Battery::BatteryLocation location);
-    static QString guessBatteryStatus(Battery *battery, Battery::BatteryLocation location);
+    static QString guessBatteryStatus(Battery *battery, const QString &status);
+    static QString getBatteryFolder(const QString &name);
+    static QString getSmapiFolder(const QString &name);
 
 
 private:
-    static QString readFileString(BatteryLocation location, QString file);
-    int readFileInt(BatteryLocation location, QString file);
-    int readBatteryCycles(BatteryLocation location);
-    static QString getBatteryFolder(BatteryLocation location);
-    static void setThreshold(Battery::BatteryLocation where, const char *what, int much);
+    friend class Sampler;
+    Sampler *sampler;
+    Estimator *estimator;
+
+    static bool setThreshold(const QString &where, const char *what, int much);
 
 };
 
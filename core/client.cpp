@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "client.h"
+#include "control.h"
+#include "paths.h"
+#include "protocol.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#define CLIENT_TIMEOUT 30
+
+bool Client::enabled = true;
+
+bool Client::isEnabled()
+{
+    /* A daemon only knows the real tree, never talk to it about a fixture */
+    return enabled && Paths::isDefault() && getenv("BATTERYCTL_NO_DAEMON") == nullptr;
+}
+
+void Client::setEnabled(bool enabled)
+{
+    Client::enabled = enabled;
+}
+
+int Client::request(const QByteArray &line, QByteArray *payload, QString *message)
+{
+    QByteArray path = Paths::getSocketFile().toLocal8Bit();
+    struct sockaddr_un address;
+
+    if (path.size() >= (int) sizeof(address.sun_path))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.constData(), path.size());
+
+    if (::connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct timeval timeout = { CLIENT_TIMEOUT, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    QByteArray data = line + "\n";
+    if (send(fd, data.constData(), data.size(), MSG_NOSIGNAL) != data.size()) {
+        close(fd);
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    /* Read until the daemon closes its end, then split header and payload */
+    QByteArray response;
+    char buffer[4096];
+    for (;;) {
+        ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0)
+            break;
+        response.append(buffer, size);
+    }
+    close(fd);
+
+    int eol = response.indexOf('\n');
+    if (eol < 0) {
+        *message = "No response from batteryctld";
+        return Control::Error::Unreachable;
+    }
+
+    int length;
+    int ret = Protocol::parseHeader(response.left(eol), &length, message);
+    *payload = response.mid(eol + 1, length);
+    if (ret == Control::Error::NoError && payload->size() != length) {
+        *message = "Truncated response from batteryctld";
+        return Control::Error::Unreachable;
+    }
+
+    return ret;
+}
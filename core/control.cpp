@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "control.h"
+#include "battery.h"
+#include "registry.h"
+#include "storage.h"
+
+#include <QStringList>
+
+#include <memory>
+
+#include <errno.h>
+#include <string.h>
+
+/* Turns the errno left behind by a failed Battery write into an error code */
+static Control::Error writeFailed(const QString &name, int error, QString *message)
+{
+    *message = QString("Could not write the thresholds of %1: %2").arg(name, strerror(error));
+
+    if (error == ENOTSUP)
+        return Control::Error::NotSupported;
+    if (error == EACCES || error == EPERM || error == EROFS)
+        return Control::Error::PermissionDenied;
+    return Control::Error::WriteFailed;
+}
+
+static QString describeWrites(const QString &name, int writes)
+{
+    if (writes == 0)
+        return QString("The thresholds of %1 are already set").arg(name);
+    return QString("Set the thresholds of %1 with %2 %3").arg(name).arg(writes).arg(writes == 1 ? "write" : "writes");
+}
+
+Control::Error Control::setThreshold(const QString &what, const QString &where, const QString &value_raw, QString *message)
+{
+    int value;
+    bool ok;
+    QString name;
+
+    value = value_raw.toInt(&ok);
+
+    if (!ok) {
+        *message = "Invalid number: " + value_raw;
+        return Control::Error::InvalidArgument;
+    }
+
+    if (what != "start" && what != "stop") {
+        int start = where.toInt(&ok);
+        if (!ok) {
+            *message = "Invalid start threshold " + where;
+            return Control::Error::InvalidArgument;
+        }
+        int stop = value;
+        name = Battery::nameFromStringConsole(what);
+        if (!Battery::isAvailable(name)) {
+            *message = "Invalid battery: " + what;
+            return Control::Error::NotAvailable;
+        }
+        Storage *storage = Storage::getStorage();
+        Control::Error ret = Control::Error::NoError;
+        int writes;
+        storage->begin();
+        if (!Battery::applyThresholds(name, start, stop, &writes)) {
+            ret = writeFailed(name, errno, message);
+        } else {
+            storage->setSettingType(name, SETTING_CUSTOM);
+            *message = describeWrites(name, writes);
+        }
+        storage->commit();
+        return ret;
+    }
+
+    name = Battery::nameFromStringConsole(where);
+
+    if (!Battery::isAvailable(name)) {
+        *message = "Battery not available: " + where;
+        return Control::Error::NotAvailable;
+    }
+
+    /* The threshold and the custom type go out in one write */
+    Storage *storage = Storage::getStorage();
+    Control::Error ret = Control::Error::NoError;
+    storage->begin();
+    if (what == "start" ? !Battery::setStartThreshold(name, value) : !Battery::setStopThreshold(name, value))
+        ret = writeFailed(name, errno, message);
+    storage->commit();
+    return ret;
+}
+
+Control::Error Control::setPreset(const QString &which, const QString &where, QString *message)
+{
+    QString name = Battery::nameFromStringConsole(where);
+    Storage *storage = Storage::getStorage();
+    int start;
+    int stop;
+
+    if (!Battery::isAvailable(name)) {
+        *message = "Unknown battery: " + where;
+        return Control::Error::NotAvailable;
+    }
+
+    if (which == SETTING_AC) {
+        start = 96;
+        stop = 100;
+    } else if (which == SETTING_AC_FULL) {
+        start = 0;
+        stop = 100;
+    } else if (which == SETTING_LIFE) {
+        start = 65;
+        stop = 85;
+    } else {
+        *message = "Unknown preset: " + which;
+        return Control::Error::InvalidArgument;
+    }
+
+    Control::Error ret = Control::Error::NoError;
+    int writes;
+    storage->begin();
+    if (!Battery::applyThresholds(name, start, stop, &writes)) {
+        ret = writeFailed(name, errno, message);
+    } else {
+        storage->setSettingType(name, which);
+        *message = describeWrites(name, writes);
+    }
+    storage->commit();
+    return ret;
+}
+
+Control::Error Control::restore(QString *message, int deadline)
+{
+    RestoreJob job(deadline);
+    return job.wait(message);
+}
+
+/*
+ * Everything shared is looked up here, on the caller's thread: the
+ * workers get the sysfs folder and the stored values and only write the
+ * thresholds, so one that misses its deadline can be abandoned in the
+ * write it is stuck in, which cannot be cancelled.
+ */
+RestoreJob::RestoreJob(int deadline) :
+    deadline(deadline), end(std::chrono::steady_clock::now() + std::chrono::milliseconds(deadline))
+{
+    Storage *storage = Storage::getStorage();
+
+    for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+        if (!supply.wearControl)
+            continue;
+
+        QByteArray folder = Battery::getBatteryFolder(supply.name).toLocal8Bit();
+        int low = storage->getStartThreshold(supply.name);
+        int high = storage->getStopThreshold(supply.name);
+        std::shared_ptr<std::promise<Result> > promise = std::make_shared<std::promise<Result> >();
+
+        workers.push_back(Worker());
+        Worker &worker = workers.back();
+        worker.name = supply.name;
+        worker.result = promise->get_future();
+        worker.thread = std::thread([promise, folder, low, high]() {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            Result result;
+            result.error = Battery::writeThresholds(folder, low, high, &result.writes) ? 0 : errno;
+            result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - begin).count();
+            promise->set_value(result);
+        });
+    }
+}
+
+RestoreJob::~RestoreJob()
+{
+    /* Joined by wait(), or stuck past the deadline and owning nothing shared */
+    for (Worker &worker : workers)
+        if (worker.thread.joinable())
+            worker.thread.detach();
+}
+
+bool RestoreJob::isDone()
+{
+    if (std::chrono::steady_clock::now() >= end)
+        return true;
+
+    for (Worker &worker : workers)
+        if (worker.result.valid() && worker.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+    return true;
+}
+
+Control::Error RestoreJob::wait(QString *message)
+{
+    Control::Error ret = Control::Error::NoError;
+
+    for (Worker &worker : workers) {
+        if (!worker.result.valid())
+            continue;
+
+        if (!message->isEmpty())
+            *message += "\n";
+
+        if (worker.result.wait_until(end) != std::future_status::ready) {
+            worker.thread.detach();
+            *message += QString("%1: timed out after %2 ms").arg(worker.name).arg(deadline);
+            ret = Control::Error::TimedOut;
+            continue;
+        }
+
+        worker.thread.join();
+        Result result = worker.result.get();
+        if (result.error != 0) {
+            QString reason;
+            Control::Error error = writeFailed(worker.name, result.error, &reason);
+            *message += QString("%1 (after %2 ms)").arg(reason).arg(result.elapsed);
+            if (ret == Control::Error::NoError)
+                ret = error;
+            continue;
+        }
+
+        *message += QString("%1: restored in %2 ms with %3 %4").arg(worker.name).arg(result.elapsed)
+                .arg(result.writes).arg(result.writes == 1 ? "write" : "writes");
+    }
+
+    return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <QString>
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+/* How long restore waits for each device, they all run at once */
+#define RESTORE_DEADLINE 5000
+/* Keep a forwarded restore well below the client timeout */
+#define RESTORE_MAX_DEADLINE 20000
+
+/*
+ * The threshold commands shared by the console, the daemon and the
+ * privileged helper. Every call returns an error code and leaves a
+ * human readable message, so each front end can report it its own way.
+ */
+class Control
+{
+public:
+
+    enum Error {
+        NoError = 0,
+        InvalidArgument = 1,
+        NotAvailable = 2,
+        NotSupported = 3,
+        WriteFailed = 4,
+        PermissionDenied = 5,
+        Unreachable = 6,
+        TimedOut = 7
+    };
+
+    static Control::Error setThreshold(const QString &what, const QString &where, const QString &value_raw, QString *message);
+    static Control::Error setPreset(const QString &which, const QString &where, QString *message);
+    static Control::Error restore(QString *message, int deadline = RESTORE_DEADLINE);
+};
+
+/*
+ * A restore in flight: every device gets its own thread, so one slow or
+ * hung embedded controller only costs its own deadline. The constructor
+ * starts the workers, wait() collects them. isDone() never blocks, so an
+ * event loop can poll it and call wait() only once it returns true.
+ */
+class RestoreJob
+{
+public:
+    explicit RestoreJob(int deadline = RESTORE_DEADLINE);
+    ~RestoreJob();
+
+    bool isDone();
+    Control::Error wait(QString *message);
+
+private:
+    /* Filled in by a worker, which must not touch anything shared */
+    struct Result {
+        int error;
+        int writes;
+        qint64 elapsed;
+    };
+
+    struct Worker {
+        QString name;
+        std::thread thread;
+        std::future<Result> result;
+    };
+
+    int deadline;
+    std::chrono::steady_clock::time_point end;
+    std::vector<Worker> workers;
+};
+
+#endif // CONTROL_H
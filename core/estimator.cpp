@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "estimator.h"
+#include "history.h"
+
+#include <math.h>
+
+Estimator::Estimator() : direction(0), timestamp(0), average(0), head(0), count(0)
+{
+}
+
+void Estimator::reset()
+{
+    head = 0;
+    count = 0;
+}
+
+void Estimator::update(Battery *battery, int64_t now)
+{
+    int status = History::encodeStatus(battery->status);
+
+    battery->time_to_empty = -1;
+    battery->time_to_full = -1;
+
+    /* A fresh state, a direction change or a long pause starts over */
+    if (count == 0 || direction != status || now - timestamp > ESTIMATOR_MAX_GAP
+            || now < timestamp) {
+        direction = status;
+        average = battery->power_now;
+        head = 0;
+        count = 0;
+    } else if (now > timestamp) {
+        double alpha = 1.0 - exp(-(now - timestamp) / 1000.0 / ESTIMATOR_TIME_CONSTANT);
+        average += alpha * (battery->power_now - average);
+    }
+
+    if (count == 0 || now > timestamp) {
+        times[head] = now;
+        energies[head] = battery->energy_now;
+        head = (head + 1) % ESTIMATOR_WINDOW;
+        if (count < ESTIMATOR_WINDOW)
+            count++;
+    }
+    timestamp = now;
+
+    double rate = average > 0 ? average : windowRate();
+    if (rate <= 0)
+        return;
+
+    if (status == History::Status::Discharging) {
+        battery->time_to_empty = battery->energy_now * 3600.0 / rate;
+    } else if (status == History::Status::Charging) {
+        int stop = battery->charge_stop_threshold > 0 && battery->charge_stop_threshold < 100
+                ? battery->charge_stop_threshold : 100;
+        double target = battery->energy_full * stop / 100.0;
+        battery->time_to_full = target > battery->energy_now ? (target - battery->energy_now) * 3600.0 / rate : 0;
+    }
+}
+
+/* Average rate of change of energy_now over the window, in µW */
+double Estimator::windowRate() const
+{
+    if (count < 2)
+        return 0;
+
+    int newest = (head + ESTIMATOR_WINDOW - 1) % ESTIMATOR_WINDOW;
+    int oldest = (head + ESTIMATOR_WINDOW - count) % ESTIMATOR_WINDOW;
+    int64_t elapsed = times[newest] - times[oldest];
+
+    if (elapsed <= 0)
+        return 0;
+    return fabs((double) (energies[newest] - energies[oldest])) * 3600000.0 / elapsed;
+}
+
+QString Estimator::formatTime(int seconds)
+{
+    if (seconds < 0)
+        return "-";
+    return QString("%1:%2 h").arg(seconds / 3600).arg(seconds / 60 % 60, 2, 10, QChar('0'));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <QString>
+
+#include <stdint.h>
+
+#include "battery.h"
+
+#define ESTIMATOR_WINDOW 32
+#define ESTIMATOR_TIME_CONSTANT 60.0
+#define ESTIMATOR_MAX_GAP (10 * 60 * 1000)
+
+/*
+ * Time to empty and time to full from the samples of one battery, in
+ * constant state. power_now feeds an exponentially weighted average; a
+ * window of the last energy_now readings gives a second rate for
+ * batteries that do not report their power. Both are reset when the
+ * battery switches between charging and discharging.
+ *
+ * Each Battery owns its estimator next to its sampler, so batteries
+ * sampled on different threads share no state.
+ */
+class Estimator
+{
+public:
+    Estimator();
+
+    void update(Battery *battery, int64_t now);
+    void reset();
+
+    static QString formatTime(int seconds);
+
+private:
+    int direction;
+    int64_t timestamp;
+    double average;
+    int64_t times[ESTIMATOR_WINDOW];
+    int64_t energies[ESTIMATOR_WINDOW];
+    int head;
+    int count;
+
+    double windowRate() const;
+};
+
+#endif // ESTIMATOR_H
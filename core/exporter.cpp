@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "exporter.h"
+#include "attributes.h"
+
+#include <QDebug>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+static const struct {
+    const char *name;
+    const char *help;
+    int attribute;
+    double scale;
+} metrics[] = {
+    { "batteryctl_capacity_percent", "Remaining charge in percent", Attributes::indexOf("capacity"), 1 },
+    { "batteryctl_energy_now_wh", "Remaining energy in watt hours", Attributes::indexOf("energy_now"), 1000000 },
+    { "batteryctl_energy_full_wh", "Energy when fully charged in watt hours", Attributes::indexOf("energy_full"), 1000000 },
+    { "batteryctl_energy_full_design_wh", "Design energy in watt hours", Attributes::indexOf("energy_full_design"), 1000000 },
+    { "batteryctl_power_watts", "Charge or discharge power in watts", Attributes::indexOf("power_now"), 1000000 },
+    { "batteryctl_voltage_volts", "Battery voltage in volts", Attributes::indexOf("voltage_now"), 1000000 },
+    { "batteryctl_cycles", "Charge cycles reported by the battery", Attributes::indexOf("cycle_count"), 1 },
+    { "batteryctl_health_percent", "Full charge energy against the design energy", Attributes::indexOf("health"), 1 },
+    { "batteryctl_charge_start_threshold_percent", "Charging starts below this charge", Attributes::indexOf("charge_start_threshold"), 1 },
+    { "batteryctl_charge_stop_threshold_percent", "Charging stops at this charge", Attributes::indexOf("charge_stop_threshold"), 1 },
+};
+
+Exporter::Exporter(const QString &directory) :
+    directory(directory), writes(0)
+{
+}
+
+void Exporter::render(const QList<Battery *> &batteries, QByteArray *output)
+{
+    char value[32];
+
+    output->clear();
+
+    for (const auto &metric : metrics) {
+        const Attribute &attribute = Attributes::table[metric.attribute];
+
+        output->append("# HELP ");
+        output->append(metric.name);
+        output->append(' ');
+        output->append(metric.help);
+        output->append("\n# TYPE ");
+        output->append(metric.name);
+        output->append(" gauge\n");
+
+        for (const Battery *battery : batteries) {
+            double raw = attribute.type == Attribute::Type::Real ? battery->*attribute.real
+                                                                 : battery->*attribute.integer;
+            output->append(metric.name);
+            output->append("{battery=\"");
+            appendLabel(battery->name, output);
+            output->append("\",serial=\"");
+            appendLabel(battery->serial_number, output);
+            output->append("\"} ");
+            int length = snprintf(value, sizeof(value), "%.9g\n", raw / metric.scale);
+            output->append(value, length);
+        }
+    }
+}
+
+bool Exporter::write(const QByteArray &metrics)
+{
+    if (metrics == last)
+        return true;
+
+    QByteArray file = getFile().toLocal8Bit();
+    QByteArray temporary = file + ".tmp";
+    int fd = open(temporary.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        qDebug() << "Could not create" << temporary << strerror(errno);
+        return false;
+    }
+
+    const char *data = metrics.constData();
+    ssize_t left = metrics.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0) {
+            qDebug() << "Could not write" << temporary << strerror(errno);
+            close(fd);
+            unlink(temporary.constData());
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+
+    close(fd);
+
+    if (rename(temporary.constData(), file.constData()) < 0) {
+        qDebug() << "Could not replace" << file << strerror(errno);
+        unlink(temporary.constData());
+        return false;
+    }
+
+    last = metrics;
+    writes++;
+    return true;
+}
+
+QString Exporter::getFile() const
+{
+    return directory + "/" EXPORTER_FILE;
+}
+
+int Exporter::getWrites() const
+{
+    return writes;
+}
+
+void Exporter::appendLabel(const QString &value, QByteArray *output)
+{
+    QByteArray utf8 = value.toUtf8();
+
+    for (int i = 0; i < utf8.size(); i++) {
+        char c = utf8.at(i);
+        if (c == '\\' || c == '"')
+            output->append('\\');
+        if (c == '\n')
+            output->append("\\n");
+        else
+            output->append(c);
+    }
+}
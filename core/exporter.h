@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "battery.h"
+
+#define EXPORTER_FILE "batteryctl.prom"
+#define EXPORTER_INTERVAL 15
+
+/*
+ * Renders the batteries as batteryctl_* gauges in the Prometheus text
+ * format for the node_exporter textfile collector. The file is replaced
+ * with a rename so the collector never sees half of it, and it is left
+ * alone when nothing changed since the last write.
+ */
+class Exporter
+{
+public:
+    explicit Exporter(const QString &directory);
+
+    static void render(const QList<Battery *> &batteries, QByteArray *output);
+
+    bool write(const QByteArray &metrics);
+    QString getFile() const;
+    int getWrites() const;
+
+private:
+    QString directory;
+    QByteArray last;
+    int writes;
+
+    static void appendLabel(const QString &value, QByteArray *output);
+};
+
+#endif // EXPORTER_H
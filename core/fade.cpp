@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fade.h"
+#include "paths.h"
+
+#include <QDebug>
+#include <QSettings>
+
+#include <math.h>
+
+void FadeFit::add(double px, double py)
+{
+    n += 1;
+    x += px;
+    y += py;
+    xx += px * px;
+    xy += px * py;
+}
+
+bool FadeFit::solve(double *intercept, double *slope) const
+{
+    double variance = n * xx - x * x;
+
+    if (n < 2 || fabs(variance) < 1e-9)
+        return false;
+
+    *slope = (n * xy - x * y) / variance;
+    *intercept = (y - *slope * x) / n;
+    return true;
+}
+
+/* Where the fitted line reaches target, only for a declining capacity */
+bool FadeFit::project(double target, double *at) const
+{
+    double intercept;
+    double slope;
+
+    if (!solve(&intercept, &slope) || slope >= 0)
+        return false;
+
+    *at = (target - intercept) / slope;
+    return true;
+}
+
+static QStringList encodeFit(const FadeFit &fit)
+{
+    QStringList sums;
+    for (double sum : { fit.n, fit.x, fit.y, fit.xx, fit.xy })
+        sums.append(QString::number(sum, 'g', 17));
+    return sums;
+}
+
+static bool decodeFit(const QStringList &sums, FadeFit *fit)
+{
+    if (sums.size() != 5)
+        return false;
+    fit->n = sums[0].toDouble();
+    fit->x = sums[1].toDouble();
+    fit->y = sums[2].toDouble();
+    fit->xx = sums[3].toDouble();
+    fit->xy = sums[4].toDouble();
+    return true;
+}
+
+FadeModel *FadeModel::instance = nullptr;
+
+FadeModel *FadeModel::getFadeModel()
+{
+    if (instance == nullptr)
+        instance = new FadeModel();
+    return instance;
+}
+
+FadeModel::FadeModel() : loaded(false)
+{
+
+}
+
+QString FadeModel::getSerial(const Battery &battery)
+{
+    QString serial = battery.serial_number.trimmed();
+
+    if (serial.isEmpty() || serial == NOT_AVAILABLE)
+        serial = battery.model_name.trimmed() + "-" + battery.name;
+    return serial.replace("/", "_");
+}
+
+bool FadeModel::update(const Battery &battery, int64_t timestamp)
+{
+    if (battery.energy_full <= 0 || battery.energy_full_design <= 0)
+        return false;
+
+    if (!loaded)
+        load();
+
+    QString serial = getSerial(battery);
+    State &state = states[serial];
+
+    if (state.cycles.n > 0 && battery.cycle_count == state.cycle_count
+            && battery.energy_full == state.energy_full && timestamp - state.last < FADE_DAY)
+        return false;
+
+    if (state.cycles.n == 0)
+        state.origin = timestamp;
+
+    state.name = battery.name;
+    state.energy_full_design = battery.energy_full_design;
+    state.last = timestamp;
+    state.cycle_count = battery.cycle_count;
+    state.energy_full = battery.energy_full;
+    state.cycles.add(battery.cycle_count, battery.energy_full);
+    state.days.add((double) (timestamp - state.origin) / FADE_DAY, battery.energy_full);
+
+    save();
+    return true;
+}
+
+bool FadeModel::load()
+{
+    QSettings settings(Paths::getFadeFile(), QSettings::IniFormat);
+
+    loaded = true;
+    states.clear();
+
+    for (const QString &serial : settings.childGroups()) {
+        State state;
+        settings.beginGroup(serial);
+        state.name = settings.value("name").toString();
+        state.energy_full_design = settings.value("energy_full_design", 0).toInt();
+        state.origin = settings.value("origin", 0).toLongLong();
+        state.last = settings.value("last", 0).toLongLong();
+        state.cycle_count = settings.value("cycle_count", 0).toInt();
+        state.energy_full = settings.value("energy_full", 0).toInt();
+        bool ok = decodeFit(settings.value("cycles").toStringList(), &state.cycles)
+                && decodeFit(settings.value("days").toStringList(), &state.days);
+        settings.endGroup();
+
+        if (ok)
+            states.insert(serial, state);
+    }
+
+    return settings.status() == QSettings::NoError;
+}
+
+bool FadeModel::save()
+{
+    QSettings settings(Paths::getFadeFile(), QSettings::IniFormat);
+
+    for (QHash<QString, State>::const_iterator i = states.constBegin(); i != states.constEnd(); ++i) {
+        const State &state = i.value();
+
+        settings.beginGroup(i.key());
+        settings.setValue("name", state.name);
+        settings.setValue("energy_full_design", state.energy_full_design);
+        settings.setValue("origin", (qlonglong) state.origin);
+        settings.setValue("last", (qlonglong) state.last);
+        settings.setValue("cycle_count", state.cycle_count);
+        settings.setValue("energy_full", state.energy_full);
+        settings.setValue("cycles", encodeFit(state.cycles));
+        settings.setValue("days", encodeFit(state.days));
+        settings.endGroup();
+    }
+
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qDebug() << "Error writing" << Paths::getFadeFile();
+        return false;
+    }
+    return true;
+}
+
+QStringList FadeModel::getSerials() const
+{
+    QStringList serials = states.keys();
+    serials.sort();
+    return serials;
+}
+
+const FadeModel::State *FadeModel::find(const QString &serial) const
+{
+    QHash<QString, State>::const_iterator i = states.constFind(serial);
+    return i == states.constEnd() ? nullptr : &i.value();
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FADE_H
+#define FADE_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <stdint.h>
+
+#include "battery.h"
+
+#define FADE_DAY (24 * 3600 * 1000LL)
+
+/* Running sums of a least-squares line y = intercept + slope * x */
+struct FadeFit
+{
+    double n;
+    double x;
+    double y;
+    double xx;
+    double xy;
+
+    void add(double px, double py);
+    bool solve(double *intercept, double *slope) const;
+    bool project(double target, double *at) const;
+};
+
+/*
+ * Capacity fade of each physical battery, keyed by its serial number so
+ * a battery keeps its history when it moves between bays or laptops.
+ * energy_full is fitted against the cycle count and against the age in
+ * days. A point is only taken when the cycle count or energy_full moves,
+ * or once a day, so frequent sampling does not skew the fit, and the
+ * whole state is a handful of sums per battery.
+ */
+class FadeModel
+{
+public:
+
+    struct State {
+        QString name;
+        int energy_full_design;
+        int64_t origin;
+        int64_t last;
+        int cycle_count;
+        int energy_full;
+        FadeFit cycles;
+        FadeFit days;
+    };
+
+    static FadeModel *instance;
+    static FadeModel *getFadeModel();
+
+    bool update(const Battery &battery, int64_t timestamp);
+    bool load();
+    bool save();
+
+    QStringList getSerials() const;
+    const FadeModel::State *find(const QString &serial) const;
+
+    static QString getSerial(const Battery &battery);
+
+private:
+    FadeModel();
+
+    QHash<QString, State> states;
+    bool loaded;
+};
+
+#endif // FADE_H
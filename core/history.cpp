@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "history.h"
+
+#include <QDebug>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define CHECKSUM_SEED 0xcbf29ce484222325ULL
+#define CHECKSUM_PRIME 0x100000001b3ULL
+
+/* Sequence numbers are 32 bits wide, a lap must be much shorter than that */
+#define HISTORY_MAX_CAPACITY (UINT32_MAX / 2)
+
+static_assert(sizeof(HistoryRecord) == 32, "HistoryRecord is part of the file format");
+static_assert(sizeof(HistoryHeader) <= HISTORY_HEADER_SIZE, "HistoryHeader must fit its page");
+
+History::History(const QString &file) :
+    file(file), mode(History::Mode::ReadOnly), fd(-1), size(0), map(nullptr), header(nullptr),
+    records(nullptr), head(0), tail(0), synced(0), generation(0)
+{
+}
+
+History::~History()
+{
+    close();
+}
+
+bool History::open(History::Mode mode, int batteries)
+{
+    struct stat info;
+    HistoryHeader check;
+    uint64_t capacity = HISTORY_BATTERY_CAPACITY * (uint64_t) qBound(1, batteries, HISTORY_MAX_BATTERIES);
+
+    close();
+    this->mode = mode;
+
+    fd = ::open(file.toLocal8Bit().constData(), mode == History::Mode::ReadWrite ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        qDebug() << "Could not open" << file << ":" << strerror(errno);
+        return false;
+    }
+
+    if (fstat(fd, &info) < 0 || (info.st_size == 0 && (mode == History::Mode::ReadOnly || !create(capacity)))) {
+        qDebug() << "Could not create" << file;
+        close();
+        return false;
+    }
+
+    if (pread(fd, &check, sizeof(check), 0) != sizeof(check)
+            || memcmp(check.magic, HISTORY_MAGIC, sizeof(check.magic)) != 0
+            || check.version != HISTORY_VERSION || check.recordSize != sizeof(HistoryRecord)
+            || check.capacity == 0 || check.capacity > HISTORY_MAX_CAPACITY) {
+        qDebug() << file << "is not a history file";
+        close();
+        return false;
+    }
+
+    size = HISTORY_HEADER_SIZE + check.capacity * sizeof(HistoryRecord);
+    if (fstat(fd, &info) < 0 || (uint64_t) info.st_size < size) {
+        qDebug() << file << "is truncated";
+        close();
+        return false;
+    }
+
+    int protection = mode == History::Mode::ReadWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *address = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        qDebug() << "Could not map" << file << ":" << strerror(errno);
+        map = nullptr;
+        close();
+        return false;
+    }
+
+    map = (char *) address;
+    header = (HistoryHeader *) map;
+    records = (HistoryRecord *) (map + HISTORY_HEADER_SIZE);
+
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++)
+        names[i] = QString::fromLatin1(header->names[i], strnlen(header->names[i], HISTORY_NAME_SIZE));
+
+    recover();
+    return true;
+}
+
+void History::close()
+{
+    if (map != nullptr) {
+        if (mode == History::Mode::ReadWrite)
+            commit();
+        munmap(map, size);
+    }
+
+    if (fd >= 0)
+        ::close(fd);
+
+    fd = -1;
+    map = nullptr;
+    header = nullptr;
+    records = nullptr;
+    head = tail = synced = generation = 0;
+}
+
+bool History::create(uint64_t capacity)
+{
+    HistoryHeader initial;
+
+    if (capacity == 0 || capacity > HISTORY_MAX_CAPACITY)
+        return false;
+
+    memset(&initial, 0, sizeof(initial));
+    memcpy(initial.magic, HISTORY_MAGIC, sizeof(initial.magic));
+    initial.version = HISTORY_VERSION;
+    initial.recordSize = sizeof(HistoryRecord);
+    initial.capacity = capacity;
+
+    /* Reserve the blocks now so appending never has to allocate */
+    off_t length = HISTORY_HEADER_SIZE + capacity * sizeof(HistoryRecord);
+    if (ftruncate(fd, length) < 0)
+        return false;
+    int ret = posix_fallocate(fd, 0, length);
+    if (ret != 0 && ret != EOPNOTSUPP && ret != EINVAL)
+        return false;
+
+    return pwrite(fd, &initial, sizeof(initial), 0) == sizeof(initial) && fsync(fd) == 0;
+}
+
+void History::recover()
+{
+    uint64_t capacity = header->capacity;
+
+    head = tail = generation = 0;
+
+    for (const HistoryCommit &commit : header->commits) {
+        if (commit.checksum != checksum(commit) || commit.generation <= generation)
+            continue;
+        if (commit.tail > commit.head || commit.head - commit.tail > capacity)
+            continue;
+        generation = commit.generation;
+        head = commit.head;
+        tail = commit.tail;
+    }
+
+    /* Take back whatever made it to the disk after the last commit */
+    for (uint64_t limit = head + capacity; head < limit; head++)
+        if (records[head % capacity].sequence != (uint32_t) (head + 1))
+            break;
+
+    if (head - tail > capacity)
+        tail = head - capacity;
+
+    synced = head;
+}
+
+int History::findBattery(const QString &name)
+{
+    QStringRef key = name.leftRef(HISTORY_NAME_SIZE - 1);
+
+    for (int i = 0; i < HISTORY_MAX_BATTERIES; i++) {
+        if (names[i].isEmpty()) {
+            QByteArray latin = key.toLatin1();
+            memcpy(header->names[i], latin.constData(), latin.size());
+            msync(map, HISTORY_HEADER_SIZE, MS_SYNC);
+            names[i] = key.toString();
+            return i;
+        }
+        if (names[i] == key)
+            return i;
+    }
+
+    return -1;
+}
+
+bool History::append(const Battery &battery, int64_t timestamp)
+{
+    if (map == nullptr || mode != History::Mode::ReadWrite)
+        return false;
+
+    int index = findBattery(battery.name);
+    if (index < 0)
+        return false;
+
+    uint64_t capacity = header->capacity;
+    if (head - tail == capacity)
+        tail++;
+
+    HistoryRecord &record = records[head % capacity];
+
+    /* Readers skip the slot while it is being rewritten */
+    record.sequence = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    record.timestamp = timestamp;
+    record.battery = index;
+    record.status = encodeStatus(battery.status);
+    record.charge_start_threshold = battery.charge_start_threshold;
+    record.charge_stop_threshold = battery.charge_stop_threshold;
+    record.capacity = battery.capacity;
+    record.energy_now = battery.energy_now;
+    record.power_now = battery.power_now;
+    record.voltage_now = battery.voltage_now;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record.sequence = (uint32_t) (head + 1);
+
+    head++;
+    return true;
+}
+
+bool History::syncRecords(uint64_t from, uint64_t to)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t start = HISTORY_HEADER_SIZE + from * sizeof(HistoryRecord);
+    size_t end = HISTORY_HEADER_SIZE + to * sizeof(HistoryRecord);
+
+    start -= start % page;
+    return msync(map + start, end - start, MS_SYNC) == 0;
+}
+
+bool History::commit()
+{
+    if (map == nullptr || mode != History::Mode::ReadWrite)
+        return false;
+
+    if (head == synced && generation > 0)
+        return true;
+
+    uint64_t capacity = header->capacity;
+    uint64_t from = synced % capacity;
+    uint64_t to = head % capacity;
+    bool ok;
+
+    if (head - synced >= capacity)
+        ok = syncRecords(0, capacity);
+    else if (from < to || head == synced)
+        ok = syncRecords(from, to);
+    else
+        ok = syncRecords(from, capacity) && syncRecords(0, to);
+
+    if (!ok) {
+        qDebug() << "Could not sync" << file << ":" << strerror(errno);
+        return false;
+    }
+
+    HistoryCommit next;
+    next.generation = generation + 1;
+    next.head = head;
+    next.tail = tail;
+    next.checksum = checksum(next);
+    header->commits[next.generation % 2] = next;
+
+    if (msync(map, HISTORY_HEADER_SIZE, MS_SYNC) < 0) {
+        qDebug() << "Could not sync" << file << ":" << strerror(errno);
+        return false;
+    }
+
+    generation = next.generation;
+    synced = head;
+    return true;
+}
+
+uint64_t History::getHead() const
+{
+    return head;
+}
+
+uint64_t History::getTail() const
+{
+    return tail;
+}
+
+uint64_t History::getCapacity() const
+{
+    return header == nullptr ? 0 : header->capacity;
+}
+
+const HistoryRecord *History::at(uint64_t index) const
+{
+    if (index < tail || index >= head)
+        return nullptr;
+
+    const HistoryRecord *record = &records[index % header->capacity];
+    if (record->sequence != (uint32_t) (index + 1))
+        return nullptr;
+    return record;
+}
+
+QString History::getBatteryName(int battery) const
+{
+    if (battery < 0 || battery >= HISTORY_MAX_BATTERIES)
+        return QString();
+    return names[battery];
+}
+
+History::Status History::encodeStatus(const QString &status)
+{
+    if (status == QLatin1String("Charging"))
+        return History::Status::Charging;
+    if (status == QLatin1String("Discharging"))
+        return History::Status::Discharging;
+    if (status.compare(QLatin1String("Not charging"), Qt::CaseInsensitive) == 0)
+        return History::Status::NotCharging;
+    if (status == QLatin1String("Full"))
+        return History::Status::Full;
+    return History::Status::Unknown;
+}
+
+QString History::decodeStatus(int status)
+{
+    switch (status) {
+    case History::Status::Charging: return "Charging";
+    case History::Status::Discharging: return "Discharging";
+    case History::Status::NotCharging: return "Not charging";
+    case History::Status::Full: return "Full";
+    default: return "Unknown";
+    }
+}
+
+uint64_t History::checksum(const HistoryCommit &commit)
+{
+    const uint64_t words[] = { commit.generation, commit.head, commit.tail };
+    uint64_t hash = CHECKSUM_SEED;
+
+    for (uint64_t word : words) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (word >> (i * 8)) & 0xff;
+            hash *= CHECKSUM_PRIME;
+        }
+    }
+
+    return hash;
+}
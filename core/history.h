@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QString>
+
+#include <stdint.h>
+
+#include "battery.h"
+
+#define HISTORY_MAGIC "BCTLHIST"
+#define HISTORY_VERSION 1
+#define HISTORY_HEADER_SIZE 4096
+#define HISTORY_MAX_BATTERIES 8
+#define HISTORY_NAME_SIZE 32
+/* Samples kept per battery: 31 days at the default 1 s record interval */
+#define HISTORY_BATTERY_CAPACITY (31 * 24 * 3600)
+#define HISTORY_SYNC_INTERVAL 60
+
+/* One sample of one battery, exactly as it is laid out in the file */
+struct HistoryRecord
+{
+    int64_t timestamp;
+    uint32_t sequence;
+    uint8_t battery;
+    uint8_t status;
+    uint8_t charge_start_threshold;
+    uint8_t charge_stop_threshold;
+    int32_t capacity;
+    int32_t energy_now;
+    int32_t power_now;
+    int32_t voltage_now;
+};
+
+/*
+ * Head and tail as of the last commit. The header keeps two of these and
+ * a commit overwrites the older one, so a torn header write always leaves
+ * the previous commit readable.
+ */
+struct HistoryCommit
+{
+    uint64_t generation;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t checksum;
+};
+
+struct HistoryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;
+    char names[HISTORY_MAX_BATTERIES][HISTORY_NAME_SIZE];
+    HistoryCommit commits[2];
+};
+
+/*
+ * Ring of fixed-size samples in a preallocated, memory-mapped file.
+ * Appending only stores into the mapping; commit() flushes the records
+ * written since the last commit and then publishes the new head and tail,
+ * so the number of syncs is bounded by how often the caller commits.
+ *
+ * Head and tail are absolute sample counts; a sample lives at slot
+ * index % capacity. Records carry the low bits of their index, so
+ * samples that reached the disk after the last commit are picked up
+ * again on open and stale slots from an earlier lap are never mistaken
+ * for new ones.
+ *
+ * The ring is shared by all batteries and sized when the file is
+ * created, HISTORY_BATTERY_CAPACITY samples for each battery present
+ * then. That keeps 31 days of 1 s samples, longer with a longer record
+ * interval; batteries that show up later share the same ring and
+ * shorten it accordingly. Delete the file to size it again.
+ */
+class History
+{
+public:
+
+    enum Mode {
+        ReadOnly, ReadWrite
+    };
+
+    enum Status {
+        Unknown, Charging, Discharging, NotCharging, Full
+    };
+
+    explicit History(const QString &file);
+    ~History();
+
+    bool open(History::Mode mode, int batteries = 1);
+    void close();
+
+    bool append(const Battery &battery, int64_t timestamp);
+    bool commit();
+
+    uint64_t getHead() const;
+    uint64_t getTail() const;
+    uint64_t getCapacity() const;
+    const HistoryRecord *at(uint64_t index) const;
+    QString getBatteryName(int battery) const;
+
+    static History::Status encodeStatus(const QString &status);
+    static QString decodeStatus(int status);
+
+private:
+    QString file;
+    History::Mode mode;
+    int fd;
+    size_t size;
+    char *map;
+    HistoryHeader *header;
+    HistoryRecord *records;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t synced;
+    uint64_t generation;
+    QString names[HISTORY_MAX_BATTERIES];
+
+    bool create(uint64_t capacity);
+    void recover();
+    int findBattery(const QString &name);
+    bool syncRecords(uint64_t from, uint64_t to);
+
+    static uint64_t checksum(const HistoryCommit &commit);
+};
+
+#endif // HISTORY_H
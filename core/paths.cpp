@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "paths.h"
+
+#include <stdlib.h>
+
+QString Paths::sysfsRoot;
+QString Paths::configFile;
+QString Paths::socketFile;
+QString Paths::historyFile;
+QString Paths::fadeFile;
+bool Paths::loaded = false;
+
+QString Paths::getPowerSupplyFolder()
+{
+    load();
+    return sysfsRoot + POWER_SUPPLY_FOLDER;
+}
+
+QString Paths::getSmapiFolder()
+{
+    load();
+    return sysfsRoot + SMAPI_FOLDER;
+}
+
+QString Paths::getConfigFile()
+{
+    load();
+    return configFile;
+}
+
+QString Paths::getSocketFile()
+{
+    load();
+    return socketFile;
+}
+
+QString Paths::getHistoryFile()
+{
+    load();
+    return historyFile;
+}
+
+QString Paths::getFadeFile()
+{
+    load();
+    return fadeFile;
+}
+
+bool Paths::isDefault()
+{
+    load();
+    return sysfsRoot.isEmpty() && configFile == CONFIG_FILE;
+}
+
+void Paths::setSysfsRoot(const QString &root)
+{
+    load();
+    sysfsRoot = root;
+    while (sysfsRoot.endsWith("/"))
+        sysfsRoot = sysfsRoot.left(sysfsRoot.length() - 1);
+}
+
+void Paths::setConfigFile(const QString &file)
+{
+    load();
+    configFile = file;
+}
+
+void Paths::setSocketFile(const QString &file)
+{
+    load();
+    socketFile = file;
+}
+
+void Paths::setHistoryFile(const QString &file)
+{
+    load();
+    historyFile = file;
+}
+
+void Paths::setFadeFile(const QString &file)
+{
+    load();
+    fadeFile = file;
+}
+
+void Paths::exportEnvironment()
+{
+    load();
+
+    if (!sysfsRoot.isEmpty())
+        setenv(SYSFS_ROOT_ENV, sysfsRoot.toLocal8Bit().constData(), 1);
+    setenv(CONFIG_FILE_ENV, configFile.toLocal8Bit().constData(), 1);
+    setenv(SOCKET_FILE_ENV, socketFile.toLocal8Bit().constData(), 1);
+    setenv(HISTORY_FILE_ENV, historyFile.toLocal8Bit().constData(), 1);
+    setenv(FADE_FILE_ENV, fadeFile.toLocal8Bit().constData(), 1);
+}
+
+void Paths::load()
+{
+    if (loaded)
+        return;
+    loaded = true;
+
+    const char *root = getenv(SYSFS_ROOT_ENV);
+    const char *config = getenv(CONFIG_FILE_ENV);
+    const char *socket = getenv(SOCKET_FILE_ENV);
+    const char *history = getenv(HISTORY_FILE_ENV);
+    const char *fade = getenv(FADE_FILE_ENV);
+
+    configFile = config != nullptr && config[0] != '\0' ? QString::fromLocal8Bit(config) : QString(CONFIG_FILE);
+    socketFile = socket != nullptr && socket[0] != '\0' ? QString::fromLocal8Bit(socket) : QString(SOCKET_FILE);
+    historyFile = history != nullptr && history[0] != '\0' ? QString::fromLocal8Bit(history) : QString(HISTORY_FILE);
+    fadeFile = fade != nullptr && fade[0] != '\0' ? QString::fromLocal8Bit(fade) : QString(FADE_FILE);
+
+    if (root != nullptr)
+        setSysfsRoot(QString::fromLocal8Bit(root));
+}
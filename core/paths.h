@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PATHS_H
+#define PATHS_H
+
+#include <QString>
+
+#define SYSFS_ROOT_ENV "BATTERYCTL_SYSFS_ROOT"
+#define CONFIG_FILE_ENV "BATTERYCTL_CONFIG"
+#define SOCKET_FILE_ENV "BATTERYCTL_SOCKET"
+#define HISTORY_FILE_ENV "BATTERYCTL_HISTORY"
+#define FADE_FILE_ENV "BATTERYCTL_FADE"
+
+#define POWER_SUPPLY_FOLDER "/sys/class/power_supply/"
+#define SMAPI_FOLDER "/sys/devices/platform/smapi/"
+#define CONFIG_FILE "/etc/batteryctl/values.conf"
+#define SOCKET_FILE "/run/batteryctl.sock"
+#define HISTORY_FILE "/var/lib/batteryctl/history"
+#define FADE_FILE "/var/lib/batteryctl/fade.conf"
+
+/*
+ * Locations of the sysfs trees and the configuration file. The sysfs
+ * paths can be moved under another root and the configuration file can
+ * be replaced, either from the environment or from the command line, so
+ * everything can run against a fixture tree instead of real hardware.
+ * The daemon socket and the history and fade model files can be moved
+ * the same way.
+ */
+class Paths
+{
+public:
+    static QString getPowerSupplyFolder();
+    static QString getSmapiFolder();
+    static QString getConfigFile();
+    static QString getSocketFile();
+    static QString getHistoryFile();
+    static QString getFadeFile();
+    static bool isDefault();
+
+    static void setSysfsRoot(const QString &root);
+    static void setConfigFile(const QString &file);
+    static void setSocketFile(const QString &file);
+    static void setHistoryFile(const QString &file);
+    static void setFadeFile(const QString &file);
+
+    /* Hands the current locations to child processes */
+    static void exportEnvironment();
+
+private:
+    static QString sysfsRoot;
+    static QString configFile;
+    static QString socketFile;
+    static QString historyFile;
+    static QString fadeFile;
+    static bool loaded;
+
+    static void load();
+};
+
+#endif // PATHS_H
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "profiler.h"
+#include "attributes.h"
+#include "battery.h"
+#include "sampler.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+LatencyHistogram::LatencyHistogram() : count(0), max(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyHistogram::add(uint64_t value)
+{
+    buckets[bucketOf(value)]++;
+    count++;
+    if (value > max)
+        max = value;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    uint64_t target = (uint64_t) (fraction * count + 0.5);
+    uint64_t seen = 0;
+
+    if (count == 0)
+        return 0;
+    if (target == 0)
+        target = 1;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target)
+            return upperBound(i) < max ? upperBound(i) : max;
+    }
+
+    return max;
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+uint64_t LatencyHistogram::getMax() const
+{
+    return max;
+}
+
+int LatencyHistogram::bucketOf(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (int) value;
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - HISTOGRAM_SUB_BITS;
+    return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+            + (int) ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyHistogram::upperBound(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t) (HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+Profiler::Profiler(const QString &name) : name(name)
+{
+}
+
+Profiler::~Profiler()
+{
+    for (const Probe &probe : probes)
+        if (probe.fd >= 0)
+            close(probe.fd);
+}
+
+bool Profiler::open()
+{
+    QByteArray folder = Battery::getBatteryFolder(name).toLocal8Bit();
+    QByteArray smapi = Battery::getSmapiFolder(name).toLocal8Bit();
+
+    for (int i = 0; i < Attributes::count; i++)
+        if (Attributes::table[i].source != Attribute::Source::Derived)
+            addProbe(Attributes::table[i].name, folder + Attributes::table[i].name, false);
+
+    addProbe("uevent", folder + "uevent", false);
+    addProbe("smapi/cycle_count", smapi + "cycle_count", false);
+
+    /* What Registry::probe and so isWearControlSupported look at */
+    addProbe("type", folder + "type", false);
+    addProbe("scope", folder + "scope", false);
+    addProbe("charge_start_threshold (access)", folder + "charge_start_threshold", true);
+    addProbe("smapi/cycle_count (access)", smapi + "cycle_count", true);
+
+    return !probes.isEmpty();
+}
+
+void Profiler::run(int iterations, uint64_t outlier)
+{
+    char buffer[SAMPLER_UEVENT_SIZE];
+    struct timespec start;
+    struct timespec end;
+
+    /* Round robin, so a slow phase of the controller hits every probe alike */
+    for (int i = 0; i < iterations; i++) {
+        for (Probe &probe : probes) {
+            bool ok;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (probe.access)
+                ok = ::access(probe.path.constData(), F_OK) == 0;
+            else
+                ok = pread(probe.fd, buffer, sizeof(buffer), 0) > 0;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            if (!ok) {
+                probe.failures++;
+                continue;
+            }
+
+            uint64_t elapsed = (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+            probe.histogram.add(elapsed);
+            if (elapsed > outlier)
+                probe.outliers++;
+        }
+    }
+}
+
+const QVector<Profiler::Probe> &Profiler::getProbes() const
+{
+    return probes;
+}
+
+void Profiler::addProbe(const QString &label, const QByteArray &path, bool access)
+{
+    Probe probe;
+    probe.label = label;
+    probe.path = path;
+    probe.access = access;
+    probe.outliers = 0;
+    probe.failures = 0;
+    probe.fd = -1;
+
+    if (access) {
+        if (::access(path.constData(), F_OK) < 0)
+            return;
+    } else {
+        probe.fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        if (probe.fd < 0)
+            return;
+    }
+
+    probes.append(probe);
+}
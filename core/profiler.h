@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <stdint.h>
+
+/* 8 linear steps per power of two, good to 12.5% */
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+#define PROFILER_ITERATIONS 1000
+#define PROFILER_OUTLIER (1000 * 1000)
+
+/*
+ * Log-linear histogram of latencies in nanoseconds, constant size and
+ * constant time per sample.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(uint64_t value);
+    uint64_t percentile(double fraction) const;
+    uint64_t getCount() const;
+    uint64_t getMax() const;
+
+private:
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t upperBound(int bucket);
+};
+
+/*
+ * Times every sysfs access batteryctl makes for one battery: the
+ * attributes the sampler reads, the uevent snapshot, the smapi cycle
+ * count and the files the registry probes for its type, scope and wear
+ * control. Attributes are read the way the sampler does, with pread()
+ * on a descriptor kept open, so the time is the driver's, usually an
+ * embedded controller round trip.
+ */
+class Profiler
+{
+public:
+    struct Probe {
+        QString label;
+        QByteArray path;
+        int fd;
+        bool access;
+        uint64_t outliers;
+        /* Reads that failed or returned nothing, not timed */
+        uint64_t failures;
+        LatencyHistogram histogram;
+    };
+
+    explicit Profiler(const QString &name);
+    ~Profiler();
+
+    bool open();
+    void run(int iterations, uint64_t outlier);
+    const QVector<Probe> &getProbes() const;
+
+private:
+    QString name;
+    QVector<Probe> probes;
+
+    void addProbe(const QString &label, const QByteArray &path, bool access);
+};
+
+#endif // PROFILER_H
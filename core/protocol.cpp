@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "protocol.h"
+#include "registry.h"
+#include "attributes.h"
+
+QByteArray Protocol::ok(const QByteArray &payload)
+{
+    return "OK " + QByteArray::number(payload.size()) + "\n" + payload;
+}
+
+QByteArray Protocol::error(Control::Error code, const QString &message)
+{
+    QByteArray line = message.toUtf8();
+    line.replace('\n', ' ');
+    return "ERR " + QByteArray::number((int) code) + " " + line + "\n";
+}
+
+QByteArray Protocol::reply(Control::Error code, const QString &message)
+{
+    if (code != Control::Error::NoError)
+        return error(code, message);
+    return ok(message.toUtf8());
+}
+
+/* RESTORE [deadline in ms]; on a bad request null, with the ERR line in *response */
+RestoreJob *Protocol::startRestore(const QList<QByteArray> &request, QByteArray *response)
+{
+    bool ok = request.size() <= 2;
+    int deadline = request.size() == 2 ? request[1].toInt(&ok) : RESTORE_DEADLINE;
+
+    if (!ok || deadline <= 0 || deadline > RESTORE_MAX_DEADLINE) {
+        *response = error(Control::Error::InvalidArgument,
+                          QString("Invalid deadline: %1 ms, at most %2").arg(QString::fromUtf8(request.value(1))).arg(RESTORE_MAX_DEADLINE));
+        return nullptr;
+    }
+
+    return new RestoreJob(deadline);
+}
+
+QByteArray Protocol::finishRestore(RestoreJob *job)
+{
+    QString message;
+    Control::Error ret = job->wait(&message);
+    return reply(ret, message);
+}
+
+QByteArray Protocol::execute(const QList<QByteArray> &request)
+{
+    QString message;
+    Control::Error ret;
+
+    if (request.isEmpty())
+        return error(Control::Error::InvalidArgument, "Empty request");
+
+    const QByteArray &command = request.first();
+
+    if (command == "PING")
+        return ok();
+
+    if (command == "INFO") {
+        QByteArray payload;
+        Battery battery;
+        for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+            battery.readBattery(supply.name);
+            encodeBattery(battery, supply.label(), &payload);
+        }
+        return ok(payload);
+    }
+
+    if (command == "RESTORE") {
+        QByteArray response;
+        RestoreJob *job = startRestore(request, &response);
+        if (job == nullptr)
+            return response;
+        response = finishRestore(job);
+        delete job;
+        return response;
+    }
+
+    if (command == "SET" && request.size() == 4)
+        ret = Control::setThreshold(request[1], request[2], request[3], &message);
+    else if (command == "PRESET" && request.size() == 3)
+        ret = Control::setPreset(request[2], request[1], &message);
+    else
+        return error(Control::Error::InvalidArgument, "Unknown request: " + QString::fromUtf8(command));
+
+    return reply(ret, message);
+}
+
+bool Protocol::isPrivileged(const QByteArray &command)
+{
+    return command == "SET" || command == "PRESET" || command == "RESTORE";
+}
+
+void Protocol::encodeBattery(const Battery &battery, const QString &label, QByteArray *payload)
+{
+    payload->append("battery=" + battery.name.toUtf8() + "\n");
+    payload->append("label=" + label.toUtf8() + "\n");
+
+    for (int i = 0; i < Attributes::count; i++) {
+        payload->append(Attributes::table[i].name);
+        payload->append('=');
+        payload->append(Attributes::encode(battery, i));
+        payload->append('\n');
+    }
+}
+
+void Protocol::decodeBatteries(const QByteArray &payload, QList<Battery *> *batteries, QStringList *labels)
+{
+    Battery *battery = nullptr;
+
+    for (const QByteArray &line : payload.split('\n')) {
+        int equals = line.indexOf('=');
+        if (equals < 0)
+            continue;
+
+        QByteArray key = line.left(equals);
+        QByteArray value = line.mid(equals + 1);
+
+        if (key == "battery") {
+            battery = new Battery();
+            battery->name = QString::fromUtf8(value);
+            battery->health = 0;
+            batteries->append(battery);
+            labels->append(battery->name);
+            continue;
+        }
+
+        if (battery == nullptr)
+            continue;
+
+        if (key == "label") {
+            labels->last() = QString::fromUtf8(value);
+            continue;
+        }
+
+        /* Keys from a newer daemon are skipped */
+        int attribute = Attributes::find(key.constData(), key.size());
+        if (attribute >= 0)
+            Attributes::decode(battery, attribute, value);
+    }
+}
+
+int Protocol::parseHeader(const QByteArray &line, int *length, QString *message)
+{
+    if (line.startsWith("OK ")) {
+        *length = line.mid(3).trimmed().toInt();
+        return Control::Error::NoError;
+    }
+
+    if (line.startsWith("ERR ")) {
+        QByteArray rest = line.mid(4).trimmed();
+        int space = rest.indexOf(' ');
+        *length = 0;
+        *message = space < 0 ? QString() : QString::fromUtf8(rest.mid(space + 1));
+        int code = (space < 0 ? rest : rest.left(space)).toInt();
+        return code == 0 ? (int) Control::Error::Unreachable : code;
+    }
+
+    *length = 0;
+    *message = "Malformed response from batteryctld";
+    return Control::Error::Unreachable;
+}
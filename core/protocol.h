@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "battery.h"
+#include "control.h"
+
+#define PROTOCOL_MAX_REQUEST 512
+
+/*
+ * The request/response protocol spoken over the daemon socket and the
+ * privileged helper channel. A request is one line of space separated
+ * words (INFO, SET, PRESET, RESTORE, PING), a response is either
+ * "OK <length>\n" followed by length bytes of payload or a single
+ * "ERR <code> <message>\n" line, where code is a Control::Error.
+ */
+class Protocol
+{
+public:
+    static QByteArray ok(const QByteArray &payload = QByteArray());
+    static QByteArray error(Control::Error code, const QString &message);
+    static QByteArray reply(Control::Error code, const QString &message);
+
+    static QByteArray execute(const QList<QByteArray> &request);
+    static bool isPrivileged(const QByteArray &command);
+
+    static RestoreJob *startRestore(const QList<QByteArray> &request, QByteArray *response);
+    static QByteArray finishRestore(RestoreJob *job);
+
+    static void encodeBattery(const Battery &battery, const QString &label, QByteArray *payload);
+    static void decodeBatteries(const QByteArray &payload, QList<Battery *> *batteries, QStringList *labels);
+
+    static int parseHeader(const QByteArray &line, int *length, QString *message);
+};
+
+#endif // PROTOCOL_H
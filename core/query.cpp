@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "query.h"
+
+#include <algorithm>
+
+HistoryQuery::HistoryQuery(Archive::Column field, int64_t bucket) :
+    field(field), bucket(bucket), since(INT64_MIN), until(INT64_MAX), scanned(0), skipped(0)
+{
+}
+
+void HistoryQuery::setRange(int64_t since, int64_t until)
+{
+    this->since = since;
+    this->until = until;
+}
+
+void HistoryQuery::setBattery(const QString &name)
+{
+    battery = name;
+}
+
+bool HistoryQuery::overlaps(int64_t first, int64_t last) const
+{
+    return last >= since && first < until;
+}
+
+bool HistoryQuery::scan(ArchiveReader *archive)
+{
+    unsigned columns = 1u << Archive::Column::Timestamp | 1u << field;
+
+    for (int i = 0; i < archive->getBlockCount(); i++) {
+        const ArchiveIndexEntry &entry = archive->getEntry(i);
+        QString name = archive->getBatteryName(entry.battery);
+
+        if (!overlaps(entry.first, entry.last) || (!battery.isEmpty() && name != battery)) {
+            skipped++;
+            continue;
+        }
+
+        if (!archive->readBlock(i, columns, &samples))
+            return false;
+
+        scanned++;
+        add(name, samples.columns[Archive::Column::Timestamp].constData(),
+            samples.columns[field].constData(), samples.count);
+    }
+
+    return true;
+}
+
+void HistoryQuery::scan(const History &history)
+{
+    QVector<int64_t> timestamps[HISTORY_MAX_BATTERIES];
+    QVector<int64_t> values[HISTORY_MAX_BATTERIES];
+
+    /* The ring is stored by row, transpose it a block at a time */
+    for (uint64_t start = history.getTail(); start < history.getHead(); start += ARCHIVE_BLOCK_SAMPLES) {
+        uint64_t end = std::min<uint64_t>(start + ARCHIVE_BLOCK_SAMPLES, history.getHead());
+        const HistoryRecord *first = history.at(start);
+        const HistoryRecord *last = history.at(end - 1);
+
+        if (first != nullptr && last != nullptr && !overlaps(first->timestamp, last->timestamp)) {
+            skipped++;
+            continue;
+        }
+
+        for (uint64_t i = start; i < end; i++) {
+            const HistoryRecord *record = history.at(i);
+            if (record == nullptr || record->battery >= HISTORY_MAX_BATTERIES)
+                continue;
+
+            int64_t value;
+            switch (field) {
+            case Archive::Column::Timestamp: value = record->timestamp; break;
+            case Archive::Column::Capacity: value = record->capacity; break;
+            case Archive::Column::EnergyNow: value = record->energy_now; break;
+            case Archive::Column::PowerNow: value = record->power_now; break;
+            case Archive::Column::VoltageNow: value = record->voltage_now; break;
+            case Archive::Column::Status: value = record->status; break;
+            case Archive::Column::ChargeStartThreshold: value = record->charge_start_threshold; break;
+            case Archive::Column::ChargeStopThreshold: value = record->charge_stop_threshold; break;
+            default: value = 0; break;
+            }
+
+            timestamps[record->battery].append(record->timestamp);
+            values[record->battery].append(value);
+        }
+
+        scanned++;
+        for (int b = 0; b < HISTORY_MAX_BATTERIES; b++) {
+            QString name = history.getBatteryName(b);
+            if (!timestamps[b].isEmpty() && (battery.isEmpty() || name == battery))
+                add(name, timestamps[b].constData(), values[b].constData(), timestamps[b].size());
+            timestamps[b].resize(0);
+            values[b].resize(0);
+        }
+    }
+}
+
+void HistoryQuery::add(const QString &battery, const int64_t *timestamps, const int64_t *values, int count)
+{
+    QMap<int64_t, HistoryBucket> &buckets = results[battery];
+
+    /* The clock may have been set back, take such blocks one sample at a time */
+    if (!std::is_sorted(timestamps, timestamps + count)) {
+        for (int i = 0; i < count; i++)
+            if (timestamps[i] >= since && timestamps[i] < until)
+                aggregate(buckets, timestamps[i] - timestamps[i] % bucket, timestamps + i, values + i, 1);
+        return;
+    }
+
+    int i = std::lower_bound(timestamps, timestamps + count, since) - timestamps;
+    int end = std::lower_bound(timestamps + i, timestamps + count, until) - timestamps;
+
+    while (i < end) {
+        int64_t start = timestamps[i] - timestamps[i] % bucket;
+        int next = std::lower_bound(timestamps + i, timestamps + end, start + bucket) - timestamps;
+        aggregate(buckets, start, timestamps + i, values + i, next - i);
+        i = next;
+    }
+}
+
+void HistoryQuery::aggregate(QMap<int64_t, HistoryBucket> &buckets, int64_t start,
+                             const int64_t *timestamps, const int64_t *values, int count)
+{
+    int64_t minimum = values[0];
+    int64_t maximum = values[0];
+    int64_t sum = 0;
+
+    for (int i = 0; i < count; i++) {
+        minimum = values[i] < minimum ? values[i] : minimum;
+        maximum = values[i] > maximum ? values[i] : maximum;
+        sum += values[i];
+    }
+
+    QMap<int64_t, HistoryBucket>::iterator found = buckets.find(start);
+    if (found == buckets.end()) {
+        HistoryBucket initial = { 0, minimum, maximum, 0, values[count - 1], INT64_MIN };
+        found = buckets.insert(start, initial);
+    }
+
+    HistoryBucket &target = found.value();
+    target.count += count;
+    target.minimum = std::min(target.minimum, minimum);
+    target.maximum = std::max(target.maximum, maximum);
+    target.sum += sum;
+    if (timestamps[count - 1] >= target.lastTimestamp) {
+        target.last = values[count - 1];
+        target.lastTimestamp = timestamps[count - 1];
+    }
+}
+
+const QMap<QString, QMap<int64_t, HistoryBucket> > &HistoryQuery::getResults() const
+{
+    return results;
+}
+
+int HistoryQuery::getScannedBlocks() const
+{
+    return scanned;
+}
+
+int HistoryQuery::getSkippedBlocks() const
+{
+    return skipped;
+}
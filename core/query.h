@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include <stdint.h>
+
+#include "archive.h"
+#include "history.h"
+
+/* Aggregate of one field over one time bucket */
+struct HistoryBucket
+{
+    int64_t count;
+    int64_t minimum;
+    int64_t maximum;
+    int64_t sum;
+    int64_t last;
+    int64_t lastTimestamp;
+};
+
+/*
+ * Summarizes one field of the recorded samples into fixed time buckets,
+ * per battery. Archive blocks outside the time range are skipped from
+ * the block index alone. Within a block the samples of a bucket are a
+ * contiguous run, found by binary search on the timestamps and reduced
+ * in a tight loop over the value column.
+ */
+class HistoryQuery
+{
+public:
+    HistoryQuery(Archive::Column field, int64_t bucket);
+
+    void setRange(int64_t since, int64_t until);
+    void setBattery(const QString &name);
+
+    bool scan(ArchiveReader *archive);
+    void scan(const History &history);
+    void add(const QString &battery, const int64_t *timestamps, const int64_t *values, int count);
+
+    const QMap<QString, QMap<int64_t, HistoryBucket> > &getResults() const;
+    int getScannedBlocks() const;
+    int getSkippedBlocks() const;
+
+private:
+    Archive::Column field;
+    int64_t bucket;
+    int64_t since;
+    int64_t until;
+    QString battery;
+    int scanned;
+    int skipped;
+    ArchiveSamples samples;
+    QMap<QString, QMap<int64_t, HistoryBucket> > results;
+
+    bool overlaps(int64_t first, int64_t last) const;
+    void aggregate(QMap<int64_t, HistoryBucket> &buckets, int64_t start,
+                   const int64_t *timestamps, const int64_t *values, int count);
+};
+
+#endif // QUERY_H
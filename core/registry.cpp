@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "registry.h"
+#include "battery.h"
+#include "paths.h"
+
+#include <QByteArray>
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+Registry* Registry::instance = nullptr;
+
+QString PowerSupply::label() const
+{
+    if (scope == PowerSupply::Scope::DeviceScope)
+        return QString("%1 - %2 (device)").arg(QString::number(index + 1), name);
+    return QString("%1 - %2").arg(QString::number(index + 1), name);
+}
+
+Registry::Registry()
+{
+    scan();
+}
+
+Registry *Registry::getRegistry()
+{
+    if (instance == nullptr)
+        instance = new Registry();
+    return instance;
+}
+
+void Registry::scan()
+{
+    batteries.clear();
+
+    DIR *dir = opendir(Paths::getPowerSupplyFolder().toLocal8Bit().constData());
+    if (dir == nullptr)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.')
+            continue;
+        PowerSupply supply;
+        if (probe(QString::fromLocal8Bit(entry->d_name), &supply))
+            batteries.append(supply);
+    }
+
+    closedir(dir);
+    reindex();
+}
+
+bool Registry::add(const QString &name)
+{
+    if (find(name) != nullptr)
+        return false;
+
+    PowerSupply supply;
+    if (!probe(name, &supply))
+        return false;
+
+    batteries.append(supply);
+    reindex();
+    return true;
+}
+
+bool Registry::remove(const QString &name)
+{
+    for (int i = 0; i < batteries.size(); i++) {
+        if (batteries[i].name == name) {
+            batteries.remove(i);
+            reindex();
+            return true;
+        }
+    }
+    return false;
+}
+
+const QVector<PowerSupply> &Registry::getBatteries() const
+{
+    return batteries;
+}
+
+const PowerSupply *Registry::find(const QString &name) const
+{
+    for (const PowerSupply &supply : batteries)
+        if (supply.name == name)
+            return &supply;
+    return nullptr;
+}
+
+bool Registry::hasWearControl() const
+{
+    for (const PowerSupply &supply : batteries)
+        if (supply.wearControl)
+            return true;
+    return false;
+}
+
+void Registry::reindex()
+{
+    /* Laptop batteries first, peripherals after them, each by name */
+    std::sort(batteries.begin(), batteries.end(), [](const PowerSupply &a, const PowerSupply &b) {
+        bool deviceA = a.scope == PowerSupply::Scope::DeviceScope;
+        bool deviceB = b.scope == PowerSupply::Scope::DeviceScope;
+        if (deviceA != deviceB)
+            return deviceB;
+        return a.name < b.name;
+    });
+
+    for (int i = 0; i < batteries.size(); i++)
+        batteries[i].index = i;
+}
+
+static int readAttribute(const QByteArray &path, char *buffer, int size)
+{
+    int fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length < 0)
+        return -1;
+    while (length > 0 && buffer[length - 1] == '\n')
+        length--;
+    buffer[length] = '\0';
+    return length;
+}
+
+bool Registry::probe(const QString &name, PowerSupply *supply)
+{
+    QByteArray folder = Battery::getBatteryFolder(name).toLocal8Bit();
+    char value[32];
+
+    if (readAttribute(folder + "type", value, sizeof(value)) < 0)
+        return false;
+
+    if (strcmp(value, "Battery") == 0)
+        supply->type = PowerSupply::Type::BatteryType;
+    else if (strcmp(value, "Mains") == 0)
+        supply->type = PowerSupply::Type::MainsType;
+    else if (strcmp(value, "UPS") == 0)
+        supply->type = PowerSupply::Type::UpsType;
+    else if (strncmp(value, "USB", 3) == 0)
+        supply->type = PowerSupply::Type::UsbType;
+    else
+        supply->type = PowerSupply::Type::UnknownType;
+
+    if (supply->type != PowerSupply::Type::BatteryType)
+        return false;
+
+    supply->scope = PowerSupply::Scope::UnknownScope;
+    if (readAttribute(folder + "scope", value, sizeof(value)) >= 0) {
+        if (strcmp(value, "System") == 0)
+            supply->scope = PowerSupply::Scope::SystemScope;
+        else if (strcmp(value, "Device") == 0)
+            supply->scope = PowerSupply::Scope::DeviceScope;
+    }
+
+    supply->name = name;
+    supply->wearControl = access((folder + "charge_start_threshold").constData(), F_OK) == 0;
+    supply->smapi = access((Battery::getSmapiFolder(name) + "cycle_count").toLocal8Bit().constData(), F_OK) == 0;
+    supply->index = -1;
+    return true;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <QString>
+#include <QVector>
+
+class PowerSupply
+{
+public:
+
+    enum Type {
+        UnknownType, BatteryType, MainsType, UpsType, UsbType
+    };
+
+    enum Scope {
+        UnknownScope, SystemScope, DeviceScope
+    };
+
+    QString name;
+    PowerSupply::Type type;
+    PowerSupply::Scope scope;
+    bool wearControl;
+    bool smapi;
+    int index;
+
+    QString label() const;
+};
+
+/*
+ * Table of the batteries under /sys/class/power_supply. The directory is
+ * scanned once, after that the table is kept up to date from add/remove
+ * uevents so callers can iterate the devices that are actually present.
+ */
+class Registry
+{
+public:
+
+    static Registry *instance;
+    static Registry *getRegistry();
+
+    void scan();
+    bool add(const QString &name);
+    bool remove(const QString &name);
+
+    const QVector<PowerSupply> &getBatteries() const;
+    const PowerSupply *find(const QString &name) const;
+    bool hasWearControl() const;
+
+private:
+    Registry();
+
+    QVector<PowerSupply> batteries;
+
+    void reindex();
+    static bool probe(const QString &name, PowerSupply *supply);
+};
+
+#endif // REGISTRY_H
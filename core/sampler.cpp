@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "sampler.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#define UEVENT_PREFIX "POWER_SUPPLY_"
+
+typedef ::Attributes Table;
+
+static constexpr int STATUS = Table::indexOf("status");
+static constexpr int CYCLE_COUNT = Table::indexOf("cycle_count");
+
+static_assert(STATUS >= 0 && CYCLE_COUNT >= 0, "The sampler needs status and cycle_count");
+
+Sampler::Sampler(const QString &name, Sampler::Mode mode) :
+    name(name), mode(mode), opened(false), stale(false), ueventFd(-1)
+{
+    for (int i = 0; i < Table::count; i++) {
+        files[i].fd = -1;
+        files[i].length = -2;
+        files[i].uevent = false;
+    }
+}
+
+Sampler::~Sampler()
+{
+    close();
+}
+
+const QString &Sampler::getName() const
+{
+    return name;
+}
+
+bool Sampler::sample(Battery *battery)
+{
+    /*
+     * A read that fails with ENODEV means the device went away under us,
+     * so drop every descriptor and give it exactly one more try.
+     */
+    for (int attempt = 0; attempt < 2; attempt++) {
+
+        if (stale)
+            close();
+
+        if (!opened && !open())
+            return false;
+
+        if (ueventFd >= 0 && !readUevent())
+            continue;
+
+        for (int i = 0; i < Table::count; i++) {
+            const Attribute &attribute = Table::table[i];
+            if (attribute.source != Attribute::Source::Dynamic)
+                continue;
+            if (attribute.type == Attribute::Type::Text)
+                readString(i, i == STATUS ? status : battery->*attribute.text);
+            else
+                battery->*attribute.integer = readInt(i);
+        }
+
+        if (stale)
+            continue;
+
+        /* These never change while the device exists, they were read in open() */
+        for (int i = 0; i < Table::count; i++) {
+            const Attribute &attribute = Table::table[i];
+            if (attribute.source != Attribute::Source::Static)
+                continue;
+            if (attribute.type == Attribute::Type::Text)
+                readString(i, battery->*attribute.text);
+            else
+                battery->*attribute.integer = parseInt(files[i].data, files[i].length);
+        }
+
+        battery->status = Battery::guessBatteryStatus(battery, status);
+        return true;
+    }
+
+    return false;
+}
+
+void Sampler::close()
+{
+    for (int i = 0; i < Table::count; i++) {
+        if (files[i].fd >= 0)
+            ::close(files[i].fd);
+        files[i].fd = -1;
+        files[i].length = -2;
+        files[i].uevent = false;
+    }
+    if (ueventFd >= 0)
+        ::close(ueventFd);
+    ueventFd = -1;
+    opened = false;
+    stale = false;
+}
+
+bool Sampler::open()
+{
+    QByteArray folder = Battery::getBatteryFolder(name).toLocal8Bit();
+    QByteArray smapi = Battery::getSmapiFolder(name).toLocal8Bit();
+    char path[PATH_MAX];
+    bool found = false;
+
+    if (mode == Sampler::Mode::Uevent) {
+        snprintf(path, sizeof(path), "%suevent", folder.constData());
+        ueventFd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (ueventFd >= 0 && readUevent())
+            found = true;
+        else if (ueventFd >= 0) {
+            ::close(ueventFd);
+            ueventFd = -1;
+        }
+    }
+
+    for (int i = 0; i < Table::count; i++) {
+        if (Table::table[i].source == Attribute::Source::Derived)
+            continue;
+
+        if (i == CYCLE_COUNT) {
+            snprintf(path, sizeof(path), "%scycle_count", smapi.constData());
+            files[i].fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (files[i].fd >= 0) {
+                files[i].uevent = false;
+                continue;
+            }
+        }
+
+        /* Covered by the uevent snapshot, no need for a descriptor */
+        if (files[i].uevent)
+            continue;
+
+        snprintf(path, sizeof(path), "%s%s", folder.constData(), Table::table[i].name);
+        files[i].fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (files[i].fd >= 0)
+            found = true;
+    }
+
+    if (!found)
+        return false;
+
+    /*
+     * The identification and design attributes are static for the lifetime
+     * of the device, read them once and keep only the value around.
+     */
+    for (int i = 0; i < Table::count; i++) {
+        File &file = files[i];
+        if (Table::table[i].source != Attribute::Source::Static || file.uevent)
+            continue;
+        int length = read(i);
+        if (file.fd >= 0)
+            ::close(file.fd);
+        file.fd = -1;
+        file.length = length;
+    }
+
+    opened = true;
+    return !stale;
+}
+
+bool Sampler::readUevent()
+{
+    ssize_t length = pread(ueventFd, uevent, SAMPLER_UEVENT_SIZE - 1, 0);
+    if (length < 0) {
+        if (errno == ENODEV || errno == ENOENT)
+            stale = true;
+        return false;
+    }
+
+    for (int i = 0; i < Table::count; i++)
+        if (files[i].uevent)
+            files[i].length = -1;
+
+    /* One pass over KEY=VALUE lines, copying out the values we know about */
+    const char *line = uevent;
+    const char *end = uevent + length;
+    const int prefix = sizeof(UEVENT_PREFIX) - 1;
+
+    while (line < end) {
+        const char *eol = (const char *) memchr(line, '\n', end - line);
+        if (eol == nullptr)
+            eol = end;
+
+        const char *equals = (const char *) memchr(line, '=', eol - line);
+        if (equals != nullptr && equals - line > prefix && memcmp(line, UEVENT_PREFIX, prefix) == 0) {
+            int attribute = ueventAttribute(line + prefix, equals - line - prefix);
+            if (attribute >= 0 && files[attribute].fd < 0) {
+                File &file = files[attribute];
+                int size = eol - equals - 1;
+                if (size > SAMPLER_VALUE_SIZE)
+                    size = SAMPLER_VALUE_SIZE;
+                memcpy(file.data, equals + 1, size);
+                file.length = size;
+                file.uevent = true;
+            }
+        }
+
+        line = eol + 1;
+    }
+
+    return true;
+}
+
+int Sampler::read(int attribute)
+{
+    File &file = files[attribute];
+    if (file.uevent)
+        return file.length;
+    if (file.fd < 0)
+        return -1;
+
+    ssize_t length = pread(file.fd, file.data, SAMPLER_VALUE_SIZE, 0);
+    if (length < 0) {
+        if (errno == ENODEV || errno == ENOENT)
+            stale = true;
+        return -1;
+    }
+
+    while (length > 0 && (file.data[length - 1] == '\n' || file.data[length - 1] == ' '))
+        length--;
+
+    return length;
+}
+
+int Sampler::readInt(int attribute)
+{
+    int length = read(attribute);
+    return parseInt(files[attribute].data, length);
+}
+
+void Sampler::readString(int attribute, QString &target)
+{
+    File &file = files[attribute];
+
+    if (file.fd >= 0)
+        file.length = read(attribute);
+
+    /* Only build a new QString when the value actually changed */
+    if (file.length < 0) {
+        if (target != QLatin1String(NOT_AVAILABLE))
+            target = QStringLiteral(NOT_AVAILABLE);
+        return;
+    }
+
+    if (target == QLatin1String(file.data, file.length))
+        return;
+
+    target = QString::fromLatin1(file.data, file.length);
+}
+
+int Sampler::ueventAttribute(const char *key, int length)
+{
+    for (int i = 0; i < Table::count; i++) {
+        const char *uevent = Table::table[i].uevent;
+        if (uevent != nullptr && strncmp(uevent, key, length) == 0 && uevent[length] == '\0')
+            return i;
+    }
+
+    return -1;
+}
+
+int Sampler::parseInt(const char *data, int length)
+{
+    int i = 0;
+    int value = 0;
+    bool negative = false;
+
+    if (length <= 0)
+        return 0;
+
+    if (data[0] == '-') {
+        negative = true;
+        i++;
+    }
+
+    for (; i < length; i++) {
+        if (data[i] < '0' || data[i] > '9')
+            return 0;
+        value = value * 10 + (data[i] - '0');
+    }
+
+    return negative ? -value : value;
+}
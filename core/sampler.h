@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <QString>
+
+#include "battery.h"
+#include "attributes.h"
+
+#define SAMPLER_VALUE_SIZE 64
+#define SAMPLER_UEVENT_SIZE 4096
+
+/*
+ * Reads the power_supply attributes of one battery. Every attribute is
+ * opened once and re-read with pread() at offset 0, so a steady-state
+ * refresh costs one syscall per attribute and no heap allocations. The
+ * descriptors are reopened only after the device disappears.
+ *
+ * In Uevent mode the whole record is taken from a single read of the
+ * device's uevent file, and only attributes the kernel does not export
+ * there (the thresholds on older kernels, the smapi cycle count) are
+ * read from their own files.
+ *
+ * Which attributes exist, and whether they are static, comes from the
+ * Attributes table; files[] is indexed the same way.
+ */
+class Sampler
+{
+public:
+
+    enum Mode {
+        Attributes, Uevent
+    };
+
+    explicit Sampler(const QString &name, Sampler::Mode mode = Sampler::Mode::Uevent);
+    ~Sampler();
+
+    const QString &getName() const;
+    bool sample(Battery *battery);
+    void close();
+
+private:
+    struct File {
+        int fd;
+        int length;
+        bool uevent;
+        char data[SAMPLER_VALUE_SIZE];
+    };
+
+    QString name;
+    Sampler::Mode mode;
+    bool opened;
+    bool stale;
+    File files[::Attributes::count];
+    int ueventFd;
+    char uevent[SAMPLER_UEVENT_SIZE];
+    QString status;
+
+    bool open();
+    bool readUevent();
+    int read(int attribute);
+    int readInt(int attribute);
+    void readString(int attribute, QString &target);
+
+    static int ueventAttribute(const char *key, int length);
+    static int parseInt(const char *data, int length);
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "sampleworker.h"
+#include "attributes.h"
+#include "paths.h"
+
+#include <QCoreApplication>
+#include <QThread>
+
+#include <time.h>
+
+static int64_t monotonicMsec()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+SampleWorker::SampleWorker(QObject *parent) : QObject(parent), timer(nullptr), monitor(nullptr)
+{
+    /* Settle the lazily loaded paths before a second thread can race for them */
+    Paths::getPowerSupplyFolder();
+}
+
+SampleWorker::~SampleWorker()
+{
+    qDeleteAll(batteries);
+}
+
+void SampleWorker::registerTypes()
+{
+    qRegisterMetaType<BatterySnapshot>("BatterySnapshot");
+    qRegisterMetaType<PowerSupplies>("PowerSupplies");
+}
+
+void SampleWorker::start()
+{
+    /* Created here so the timer and the socket notifier belong to this thread */
+    timer = new QTimer(this);
+    monitor = new UeventMonitor(this);
+
+    timer->setSingleShot(true);
+    if (!monitor->isListening())
+        scheduler.setMaximum(SAMPLE_WORKER_POLL_MAX);
+
+    connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    connect(monitor, SIGNAL(supplyChanged(QString,QString)), this, SLOT(supplyChanged(QString,QString)));
+    connect(monitor, SIGNAL(overflowed()), this, SLOT(rescan()));
+
+    rebuild();
+    refresh();
+}
+
+void SampleWorker::refresh()
+{
+    for (Battery *battery : batteries)
+        sample(battery);
+    reschedule();
+}
+
+void SampleWorker::setVisible(bool visible)
+{
+    scheduler.setVisible(visible);
+
+    /* Not started yet, start() samples anyway */
+    if (timer == nullptr)
+        return;
+
+    if (visible)
+        refresh();
+    else
+        timer->stop();
+}
+
+void SampleWorker::supplyChanged(QString name, QString action)
+{
+    Registry *registry = Registry::getRegistry();
+
+    if (action == "add" || action == "remove") {
+        if (action == "add" ? registry->add(name) : registry->remove(name)) {
+            rebuild();
+            refresh();
+        }
+        return;
+    }
+
+    if (action != "change") {
+        refresh();
+        return;
+    }
+
+    for (Battery *battery : batteries) {
+        if (battery->name == name) {
+            sample(battery);
+            reschedule();
+            return;
+        }
+    }
+
+    /* A battery we missed the add event for */
+    if (registry->add(name))
+        rebuild();
+
+    /* An AC adapter changed, which flips the status of every battery */
+    refresh();
+}
+
+/* Uevents were lost, so the device list may be stale */
+void SampleWorker::rescan()
+{
+    Registry::getRegistry()->scan();
+    rebuild();
+    refresh();
+}
+
+void SampleWorker::rebuild()
+{
+    Registry *registry = Registry::getRegistry();
+    const QVector<PowerSupply> &supplies = registry->getBatteries();
+
+    qDeleteAll(batteries);
+    batteries.clear();
+    scheduler.reset();
+
+    for (const PowerSupply &supply : supplies) {
+        batteries.append(new Battery());
+        batteries.last()->name = supply.name;
+    }
+
+    emit suppliesChanged(supplies, registry->hasWearControl());
+}
+
+void SampleWorker::sample(Battery *battery)
+{
+    battery->readBattery(battery->name);
+    scheduler.sampled(*battery, monotonicMsec());
+
+    Battery *copy = new Battery();
+    copy->name = battery->name;
+    for (int i = 0; i < Attributes::count; i++)
+        Attributes::copy(copy, *battery, i);
+
+    /* Released by the receivers, so hand the QObject over to their thread */
+    copy->moveToThread(QCoreApplication::instance()->thread());
+    emit batterySampled(BatterySnapshot(copy));
+}
+
+void SampleWorker::reschedule()
+{
+    int interval = scheduler.next(batteries, monotonicMsec());
+    if (interval < 0)
+        timer->stop();
+    else
+        timer->start(interval);
+}
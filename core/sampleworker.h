@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SAMPLEWORKER_H
+#define SAMPLEWORKER_H
+
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVector>
+
+#include "battery.h"
+#include "registry.h"
+#include "scheduler.h"
+#include "ueventmonitor.h"
+
+/* Without uevents a plugged in charger is only noticed by polling */
+#define SAMPLE_WORKER_POLL_MAX 30000
+
+typedef QSharedPointer<const Battery> BatterySnapshot;
+typedef QVector<PowerSupply> PowerSupplies;
+
+Q_DECLARE_METATYPE(BatterySnapshot)
+Q_DECLARE_METATYPE(PowerSupplies)
+
+/*
+ * Does all the sysfs work of a view on its own thread: owns the
+ * registry, the uevent monitor and one sampling Battery per device, and
+ * paces itself with a Scheduler. Every device is published on its own as
+ * soon as it was read, as a copy nobody writes to again, so a slow
+ * embedded controller read holds back that device and never the event
+ * loop of the view. Move it to a QThread and call start() from there.
+ */
+class SampleWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SampleWorker(QObject *parent = 0);
+    ~SampleWorker();
+
+    static void registerTypes();
+
+public slots:
+    void start();
+    void refresh();
+    void setVisible(bool visible);
+
+signals:
+    void suppliesChanged(const PowerSupplies &supplies, bool wearControl);
+    void batterySampled(const BatterySnapshot &battery);
+
+private slots:
+    void supplyChanged(QString name, QString action);
+    void rescan();
+
+private:
+    QList<Battery *> batteries;
+    Scheduler scheduler;
+    QTimer *timer;
+    UeventMonitor *monitor;
+
+    void rebuild();
+    void sample(Battery *battery);
+    void reschedule();
+};
+
+#endif // SAMPLEWORKER_H
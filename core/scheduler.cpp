@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "scheduler.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+Scheduler::Scheduler() : visible(true), maximum(SCHEDULER_IDLE_INTERVAL)
+{
+}
+
+void Scheduler::setVisible(bool visible)
+{
+    this->visible = visible;
+}
+
+bool Scheduler::isVisible() const
+{
+    return visible;
+}
+
+void Scheduler::setMaximum(int msec)
+{
+    maximum = msec;
+}
+
+void Scheduler::sampled(const Battery &battery, int64_t timestamp)
+{
+    QHash<QString, State>::iterator state = states.find(battery.name);
+
+    if (state == states.end()) {
+        State fresh;
+        fresh.status = battery.status;
+        fresh.timestamp = timestamp;
+        fresh.power_now = battery.power_now;
+        fresh.energy_now = battery.energy_now;
+        fresh.capacity = battery.capacity;
+        fresh.transition = 0;
+        fresh.rate = 0;
+        fresh.deadline = timestamp + qMin(SCHEDULER_ACTIVE_INTERVAL, maximum);
+        states.insert(battery.name, fresh);
+        return;
+    }
+
+    state.value().deadline = timestamp + qMin(interval(&state.value(), battery, timestamp), maximum);
+}
+
+int Scheduler::next(const QList<Battery *> &batteries, int64_t timestamp)
+{
+    int64_t result = maximum;
+
+    if (!visible)
+        return -1;
+
+    for (const Battery *battery : batteries) {
+        QHash<QString, State>::const_iterator state = states.constFind(battery->name);
+        if (state == states.constEnd())
+            result = qMin(result, (int64_t) SCHEDULER_ACTIVE_INTERVAL);
+        else
+            result = qMin(result, state.value().deadline - timestamp);
+    }
+
+    return (int) qMax(result, (int64_t) SCHEDULER_FAST_INTERVAL);
+}
+
+void Scheduler::reset()
+{
+    states.clear();
+}
+
+int Scheduler::interval(State *state, const Battery &battery, int64_t timestamp)
+{
+    double elapsed = (timestamp - state->timestamp) / 1000.0;
+
+    if (battery.status != state->status) {
+        state->transition = SCHEDULER_TRANSITION_SAMPLES;
+    } else if (elapsed > 0) {
+        double base = qMax(abs(state->power_now), 1000000);
+        if (abs(battery.power_now - state->power_now) / base / elapsed > SCHEDULER_POWER_SWING)
+            state->transition = SCHEDULER_TRANSITION_SAMPLES;
+    }
+
+    /* energy_now moves in finer steps than capacity where it is reported */
+    if (elapsed > 0) {
+        double rate;
+        if (battery.energy_full > 0)
+            rate = fabs(battery.energy_now - state->energy_now) * 100.0 / battery.energy_full / elapsed;
+        else
+            rate = abs(battery.capacity - state->capacity) / elapsed;
+        state->rate = (state->rate + rate) / 2;
+    }
+
+    state->status = battery.status;
+    state->timestamp = timestamp;
+    state->power_now = battery.power_now;
+    state->energy_now = battery.energy_now;
+    state->capacity = battery.capacity;
+
+    if (state->transition > 0) {
+        state->transition--;
+        return SCHEDULER_FAST_INTERVAL;
+    }
+
+    if (battery.status != "Charging" && battery.status != "Discharging")
+        return SCHEDULER_IDLE_INTERVAL;
+
+    /* Twice for every percent of charge gained or lost */
+    if (state->rate <= 0)
+        return SCHEDULER_SLOW_INTERVAL;
+    double msec = 500.0 / state->rate;
+    return msec > SCHEDULER_SLOW_INTERVAL ? SCHEDULER_SLOW_INTERVAL
+                                          : qMax((int) msec, SCHEDULER_ACTIVE_INTERVAL);
+}
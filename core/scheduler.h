@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <stdint.h>
+
+#include "battery.h"
+
+#define SCHEDULER_FAST_INTERVAL 500
+#define SCHEDULER_ACTIVE_INTERVAL 2000
+#define SCHEDULER_SLOW_INTERVAL 30000
+#define SCHEDULER_IDLE_INTERVAL (5 * 60 * 1000)
+/* Samples taken at the fast interval after a transition */
+#define SCHEDULER_TRANSITION_SAMPLES 4
+/* A change of power by this fraction per second counts as a transition */
+#define SCHEDULER_POWER_SWING 0.2
+
+/*
+ * Picks the time of the next sample from what the batteries are doing.
+ * A status change or a swing in power_now is a transition and is
+ * followed closely; while charging or discharging the interval follows
+ * how fast the charge moves, and a battery that sits full or at its
+ * threshold is only looked at every few minutes. Nothing is sampled
+ * while nobody is watching.
+ *
+ * Each battery keeps its own deadline, moved only by sampled(), so a
+ * battery refreshed on its own does not disturb the pace of the others.
+ */
+class Scheduler
+{
+public:
+    Scheduler();
+
+    void setVisible(bool visible);
+    bool isVisible() const;
+    void setMaximum(int msec);
+
+    void sampled(const Battery &battery, int64_t timestamp);
+    /* Milliseconds until the next sample, -1 to pause */
+    int next(const QList<Battery *> &batteries, int64_t timestamp);
+    void reset();
+
+private:
+    struct State {
+        QString status;
+        int64_t timestamp;
+        int power_now;
+        int energy_now;
+        int capacity;
+        int transition;
+        /* Percent of a full charge per second, smoothed */
+        double rate;
+        int64_t deadline;
+    };
+
+    QHash<QString, State> states;
+    bool visible;
+    int maximum;
+
+    static int interval(State *state, const Battery &battery, int64_t timestamp);
+};
+
+#endif // SCHEDULER_H
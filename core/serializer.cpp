@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "serializer.h"
+#include "attributes.h"
+
+#include <stdio.h>
+#include <time.h>
+
+bool Serializer::parseFormat(const QString &name, Serializer::Format *format)
+{
+    if (name == "text")
+        *format = Serializer::Format::Text;
+    else if (name == "json")
+        *format = Serializer::Format::Json;
+    else if (name == "csv")
+        *format = Serializer::Format::Csv;
+    else
+        return false;
+    return true;
+}
+
+Serializer::Serializer(Serializer::Format format, QByteArray *output) :
+    format(format), output(output), count(0)
+{
+}
+
+void Serializer::begin()
+{
+    output->reserve(output->size() + 8 * SERIALIZER_BATTERY_SIZE);
+
+    if (format == Serializer::Format::JsonLines)
+        return;
+
+    if (format == Serializer::Format::Json) {
+        output->append("{\"schema\":" SERIALIZER_SCHEMA ",\"batteries\":[");
+        return;
+    }
+
+    output->append("battery,label");
+    for (int i = 0; i < Attributes::count; i++) {
+        output->append(',');
+        output->append(Attributes::table[i].name);
+    }
+    output->append('\n');
+}
+
+void Serializer::add(const Battery &battery, const QString &label, const bool *columns)
+{
+    if (format == Serializer::Format::Csv) {
+        appendText(battery.name);
+        output->append(',');
+        appendText(label);
+        for (int i = 0; i < Attributes::count; i++) {
+            output->append(',');
+            appendValue(battery, i);
+        }
+        output->append('\n');
+        count++;
+        return;
+    }
+
+    if (count > 0 && format == Serializer::Format::Json)
+        output->append(',');
+    output->append('{');
+
+    if (format == Serializer::Format::JsonLines) {
+        struct timespec now;
+        char time[32];
+        clock_gettime(CLOCK_REALTIME, &now);
+        int length = snprintf(time, sizeof(time), "\"time\":%lld,", now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+        output->append(time, length);
+    }
+
+    output->append("\"battery\":");
+    appendText(battery.name);
+    output->append(",\"label\":");
+    appendText(label);
+    for (int i = 0; i < Attributes::count; i++) {
+        if (columns != nullptr && !columns[i])
+            continue;
+        output->append(",\"");
+        output->append(Attributes::table[i].name);
+        output->append("\":");
+        appendValue(battery, i);
+    }
+    output->append(format == Serializer::Format::JsonLines ? "}\n" : "}");
+    count++;
+}
+
+void Serializer::end()
+{
+    if (format == Serializer::Format::Json)
+        output->append("]}\n");
+}
+
+void Serializer::appendValue(const Battery &battery, int attribute)
+{
+    const Attribute &entry = Attributes::table[attribute];
+    char number[32];
+    int length;
+
+    switch (entry.type) {
+    case Attribute::Type::Text:
+        /* Not reported, null in JSON and an empty CSV field */
+        if (battery.*entry.text == QLatin1String(NOT_AVAILABLE)) {
+            if (format != Serializer::Format::Csv)
+                output->append("null");
+            return;
+        }
+        appendText(battery.*entry.text);
+        return;
+    case Attribute::Type::Real:
+        length = snprintf(number, sizeof(number), "%.2f", battery.*entry.real);
+        break;
+    case Attribute::Type::Duration:
+        /* No estimate yet, the same */
+        if (battery.*entry.integer < 0) {
+            if (format != Serializer::Format::Csv)
+                output->append("null");
+            return;
+        }
+        length = snprintf(number, sizeof(number), "%d", battery.*entry.integer);
+        break;
+    case Attribute::Type::Integer:
+    default:
+        length = snprintf(number, sizeof(number), "%d", battery.*entry.integer);
+        break;
+    }
+
+    output->append(number, length);
+}
+
+/*
+ * Appends a JSON string or CSV field. sysfs strings are short ASCII, so
+ * those are narrowed on the stack instead of through a UTF-8 copy.
+ */
+void Serializer::appendText(const QString &value)
+{
+    char ascii[SERIALIZER_FIELD_SIZE];
+    const QChar *data = value.constData();
+    int size = value.size();
+    bool narrow = size <= SERIALIZER_FIELD_SIZE;
+
+    for (int i = 0; i < size && narrow; i++) {
+        ushort c = data[i].unicode();
+        narrow = c < 0x80;
+        ascii[i] = (char) c;
+    }
+
+    if (!narrow) {
+        QByteArray utf8 = value.toUtf8();
+        if (format == Serializer::Format::Csv)
+            appendCsvField(utf8.constData(), utf8.size());
+        else
+            appendJsonString(utf8.constData(), utf8.size(), output);
+        return;
+    }
+
+    if (format == Serializer::Format::Csv)
+        appendCsvField(ascii, size);
+    else
+        appendJsonString(ascii, size, output);
+}
+
+void Serializer::appendJsonString(const QByteArray &value, QByteArray *output)
+{
+    appendJsonString(value.constData(), value.size(), output);
+}
+
+void Serializer::appendJsonString(const char *value, int size, QByteArray *output)
+{
+    output->append('"');
+    for (int i = 0; i < size; i++) {
+        char c = value[i];
+        if (c == '"' || c == '\\') {
+            output->append('\\');
+            output->append(c);
+        } else if ((unsigned char) c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) c);
+            output->append(escape, 6);
+        } else {
+            output->append(c);
+        }
+    }
+    output->append('"');
+}
+
+void Serializer::appendCsvField(const char *value, int size)
+{
+    bool quote = false;
+    for (int i = 0; i < size && !quote; i++) {
+        char c = value[i];
+        quote = c == ',' || c == '"' || c == '\n' || c == '\r';
+    }
+
+    if (!quote) {
+        output->append(value, size);
+        return;
+    }
+
+    output->append('"');
+    for (int i = 0; i < size; i++) {
+        if (value[i] == '"')
+            output->append('"');
+        output->append(value[i]);
+    }
+    output->append('"');
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "battery.h"
+
+#define SERIALIZER_SCHEMA "1"
+#define SERIALIZER_BATTERY_SIZE 1024
+/* Longer or non-ASCII strings go through a UTF-8 copy */
+#define SERIALIZER_FIELD_SIZE 64
+
+/*
+ * Machine readable renderings of batteries for scripts and inventory
+ * agents. The columns are the Attributes table in raw kernel units
+ * (uWh, uW, uV, percent, seconds), so the schema only ever grows. JSON
+ * is one document with a "batteries" array, CSV is a header line and
+ * one row per battery. JsonLines writes one self-contained object per
+ * battery and line, stamped with the wall clock, and can be limited to
+ * the columns that changed. Attributes the kernel does not report are
+ * null in JSON and empty in CSV. Everything is appended to one caller-owned
+ * buffer so a whole report is a single write.
+ */
+class Serializer
+{
+public:
+
+    enum Format {
+        Text, Json, Csv, JsonLines
+    };
+
+    static bool parseFormat(const QString &name, Serializer::Format *format);
+
+    Serializer(Serializer::Format format, QByteArray *output);
+
+    void begin();
+    void add(const Battery &battery, const QString &label, const bool *columns = nullptr);
+    void end();
+
+    static void appendJsonString(const QByteArray &value, QByteArray *output);
+    static void appendJsonString(const char *value, int size, QByteArray *output);
+
+private:
+    Serializer::Format format;
+    QByteArray *output;
+    int count;
+
+    void appendValue(const Battery &battery, int attribute);
+    void appendText(const QString &value);
+    void appendCsvField(const char *value, int size);
+};
+
+#endif // SERIALIZER_H
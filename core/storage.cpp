@@ -25,6 +25,7 @@
 */
 
 #include "storage.h"
+#include "paths.h"
 
 #include <QDebug>
 
@@ -35,32 +36,18 @@ Storage::~Storage()
     delete settings;
 }
 
-Storage::Storage()
+Storage::Storage() : depth(0)
 {
-    mutex.lock();
-    settings = new QSettings("/etc/batteryctl/values.conf", QSettings::IniFormat);
+    settings = new QSettings(Paths::getConfigFile(), QSettings::IniFormat);
     if (settings->status() != QSettings::NoError) {
         qDebug() << "Error opening settings file!";
         exit(1);
     }
-    settings->beginGroup("Primary");
-    QString type = settings->value("type", "none").toString();
-    if (type == "none") {
-        settings->setValue("type", SETTING_AC_FULL);
-        settings->setValue("start", 0);
-        settings->setValue("stop", 100);
-    }
-    settings->endGroup();
-
-    settings->beginGroup("Secondary");
-    type = settings->value("type", "none").toString();
-    if (type == "none") {
-        settings->setValue("type", SETTING_AC_FULL);
-        settings->setValue("start", 0);
-        settings->setValue("stop", 100);
-    }
-    settings->endGroup();
-    mutex.unlock();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    settings->setAtomicSyncRequired(true);
+#endif
+
+    /* No seeding from the Registry, the GUI's sampling thread owns it; the getters default to full */
 }
 
 Storage *Storage::getStorage()
@@ -70,70 +57,138 @@ Storage *Storage::getStorage()
     return instance;
 }
 
-int Storage::getStartThreshold(Battery::BatteryLocation location)
+int Storage::getStartThreshold(const QString &name)
+{
+    return value(name, "start", 0).toInt();
+}
+
+int Storage::getStopThreshold(const QString &name)
+{
+    return value(name, "stop", 100).toInt();
+}
+
+QString Storage::getSettingType(const QString &name)
 {
+    return value(name, "type", SETTING_AC_FULL).toString();
+}
+
+QList<int> Storage::getReplacementThresholds()
+{
+    QList<int> thresholds;
+
     mutex.lock();
-    beginGroup(location);
-    int ret =  settings->value("start", 0).toInt();
-    settings->endGroup();
+    QStringList values = settings->value("Fade/replace", QString(REPLACEMENT_THRESHOLDS).split(",")).toStringList();
     mutex.unlock();
-    return ret;
+
+    for (const QString &value : values) {
+        bool ok;
+        int threshold = value.trimmed().toInt(&ok);
+        if (ok && threshold > 0 && threshold < 100)
+            thresholds.append(threshold);
+    }
+    return thresholds;
+}
+
+void Storage::setStartThreshold(const QString &name, int value)
+{
+    stage(name, "start", value);
+}
+
+void Storage::setStopThreshold(const QString &name, int value)
+{
+    stage(name, "stop", value);
+}
+
+void Storage::setSettingType(const QString &name, QString type)
+{
+    stage(name, "type", type);
 }
 
-int Storage::getStopThreshold(Battery::BatteryLocation location)
+void Storage::begin()
 {
     mutex.lock();
-    beginGroup(location);
-    int ret = settings->value("stop", 100).toInt();
-    settings->endGroup();
+    depth++;
     mutex.unlock();
-    return ret;
 }
 
-QString Storage::getSettingType(Battery::BatteryLocation location)
+bool Storage::commit()
 {
     mutex.lock();
-    beginGroup(location);
-    QString ret = settings->value("type", SETTING_AC_FULL).toString();
-    settings->endGroup();
+    if (depth > 0)
+        depth--;
+    bool ok = depth > 0 || flushLocked();
     mutex.unlock();
-    return ret;
+    return ok;
+}
+
+/*
+ * Writes everything staged since the outermost begin() with a single
+ * sync, which QSettings does by writing a temporary file and renaming it
+ * over the configuration. Values that are already stored are dropped, so
+ * a commit that changes nothing does not touch the file. Called with the
+ * mutex held.
+ */
+bool Storage::flushLocked()
+{
+    bool ok = true;
+    bool changed = false;
+
+    for (QMap<QString, QVariant>::const_iterator i = staged.constBegin(); i != staged.constEnd(); ++i) {
+        if (settings->contains(i.key()) && settings->value(i.key()).toString() == i.value().toString())
+            continue;
+        settings->setValue(i.key(), i.value());
+        changed = true;
+    }
+    staged.clear();
+
+    if (changed) {
+        settings->sync();
+        ok = settings->status() == QSettings::NoError;
+        if (!ok)
+            qDebug() << "Error writing settings file!";
+    }
+    return ok;
 }
 
-void Storage::setStartThreshold(Battery::BatteryLocation location, int value)
+/* Like commit(), the staged values are only dropped by the outermost level */
+void Storage::rollback()
 {
     mutex.lock();
-    beginGroup(location);
-    settings->setValue("start", value);
-    settings->endGroup();
-    settings->sync();
+    if (depth > 0)
+        depth--;
+    if (depth == 0)
+        staged.clear();
     mutex.unlock();
 }
 
-void Storage::setStopThreshold(Battery::BatteryLocation location, int value)
+QVariant Storage::value(const QString &name, const char *key, const QVariant &fallback)
 {
+    QString path = getGroup(name) + "/" + key;
+
     mutex.lock();
-    beginGroup(location);
-    settings->setValue("stop", value);
-    settings->endGroup();
-    settings->sync();
+    QVariant ret = staged.contains(path) ? staged.value(path) : settings->value(path, fallback);
     mutex.unlock();
+    return ret;
 }
 
-void Storage::setSettingType(Battery::BatteryLocation location, QString type)
+void Storage::stage(const QString &name, const char *key, const QVariant &value)
 {
+    QString path = getGroup(name) + "/" + key;
+
+    /* Outside of a transaction every change is its own commit, under the same lock */
     mutex.lock();
-    beginGroup(location);
-    settings->setValue("type", type);
-    settings->endGroup();
-    settings->sync();
+    staged.insert(path, value);
+    if (depth == 0)
+        flushLocked();
     mutex.unlock();
 }
 
-void Storage::beginGroup(Battery::BatteryLocation location)
+QString Storage::getGroup(const QString &name)
 {
-    if (location == Battery::BatteryLocation::Primary)
-        settings->beginGroup("Primary");
-    else
-        settings->beginGroup("Secondary");
+    /* The first two batteries keep their group names from older versions */
+    if (name == PRIMARY)
+        return "Primary";
+    if (name == SECONDARY)
+        return "Secondary";
+    return name;
 }
@@ -29,6 +29,8 @@
 
 #include <QSettings>
 #include <QMutex>
+#include <QMap>
+#include <QVariant>
 
 #include "battery.h"
 
@@ -37,6 +39,9 @@
 #define SETTING_AC_FULL "full"
 #define SETTING_LIFE "life"
 
+/* Percentages of the design capacity at which a battery should be replaced */
+#define REPLACEMENT_THRESHOLDS "80,70"
+
 class Storage;
 
 class Storage
@@ -50,17 +55,29 @@ public:
 
     QMutex mutex;
 
-    int getStartThreshold(Battery::BatteryLocation location);
-    int getStopThreshold(Battery::BatteryLocation location);
-    QString getSettingType(Battery::BatteryLocation location);
+    int getStartThreshold(const QString &name);
+    int getStopThreshold(const QString &name);
+    QString getSettingType(const QString &name);
+    QList<int> getReplacementThresholds();
+
+    void setStartThreshold(const QString &name, int value);
+    void setStopThreshold(const QString &name, int value);
+    void setSettingType(const QString &name, QString type);
 
-    void setStartThreshold(Battery::BatteryLocation location, int value);
-    void setStopThreshold(Battery::BatteryLocation location, int value);
-    void setSettingType(Battery::BatteryLocation location, QString type);
+    /* Setters between begin() and commit() are written out together */
+    void begin();
+    bool commit();
+    void rollback();
 
 private:
     QSettings *settings;
-    void beginGroup(Battery::BatteryLocation location);
+    QMap<QString, QVariant> staged;
+    int depth;
+
+    bool flushLocked();
+    QVariant value(const QString &name, const char *key, const QVariant &fallback);
+    void stage(const QString &name, const char *key, const QVariant &value);
+    static QString getGroup(const QString &name);
 };
 
 #endif // STORAGE_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ueventmonitor.h"
+
+#include <QDebug>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+UeventMonitor::UeventMonitor(QObject *parent) : QObject(parent), fd(-1), notifier(nullptr)
+{
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        qDebug() << "Error opening uevent socket: " << strerror(errno);
+        return;
+    }
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1; /* kernel events, not the udev rebroadcast */
+
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        qDebug() << "Error binding uevent socket: " << strerror(errno);
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+}
+
+UeventMonitor::~UeventMonitor()
+{
+    delete notifier;
+    if (fd >= 0)
+        close(fd);
+}
+
+bool UeventMonitor::isListening() const
+{
+    return fd >= 0;
+}
+
+void UeventMonitor::readEvents()
+{
+    bool lost = false;
+
+    for (;;) {
+        struct sockaddr_nl sender;
+        socklen_t length = sizeof(sender);
+
+        ssize_t size = recvfrom(fd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr *) &sender, &length);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            /* Reported once, the events still queued are read after it */
+            if (errno == ENOBUFS) {
+                lost = true;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qDebug() << "Error reading uevent socket: " << strerror(errno);
+            if (lost)
+                emit overflowed();
+            return;
+        }
+
+        /* Only trust messages that come from the kernel itself */
+        if (sender.nl_pid != 0)
+            continue;
+
+        buffer[size] = '\0';
+
+        /* "action@devpath\0KEY=VALUE\0KEY=VALUE\0..." */
+        const char *action = nullptr;
+        const char *devpath = nullptr;
+        const char *name = nullptr;
+        bool powerSupply = false;
+
+        for (const char *field = buffer; field < buffer + size; field += strlen(field) + 1) {
+            if (strncmp(field, "ACTION=", 7) == 0)
+                action = field + 7;
+            else if (strncmp(field, "DEVPATH=", 8) == 0)
+                devpath = field + 8;
+            else if (strncmp(field, "SUBSYSTEM=", 10) == 0)
+                powerSupply = strcmp(field + 10, "power_supply") == 0;
+            else if (strncmp(field, "POWER_SUPPLY_NAME=", 18) == 0)
+                name = field + 18;
+        }
+
+        if (!powerSupply || action == nullptr)
+            continue;
+
+        if (name == nullptr && devpath != nullptr) {
+            name = strrchr(devpath, '/');
+            name = name == nullptr ? devpath : name + 1;
+        }
+
+        if (name == nullptr)
+            continue;
+
+        emit supplyChanged(QString::fromLatin1(name), QString::fromLatin1(action));
+    }
+}
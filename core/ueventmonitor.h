@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef UEVENTMONITOR_H
+#define UEVENTMONITOR_H
+
+#include <QObject>
+#include <QString>
+#include <QSocketNotifier>
+
+#define UEVENT_BUFFER_SIZE 8192
+
+/*
+ * Listens on the kernel's NETLINK_KOBJECT_UEVENT socket and reports
+ * add/remove/change events of the power_supply subsystem, so callers can
+ * refresh only the device that changed instead of polling. When the
+ * socket buffer overflows, events are lost and overflowed() tells the
+ * listeners to rescan the devices from sysfs.
+ */
+class UeventMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UeventMonitor(QObject *parent = 0);
+    ~UeventMonitor();
+
+    bool isListening() const;
+
+signals:
+    void supplyChanged(QString name, QString action);
+    void overflowed();
+
+private slots:
+    void readEvents();
+
+private:
+    int fd;
+    QSocketNotifier *notifier;
+    char buffer[UEVENT_BUFFER_SIZE];
+};
+
+#endif // UEVENTMONITOR_H
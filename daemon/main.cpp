@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include "server.h"
+#include "core/paths.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static int signalPipe[2];
+
+static void handleSignal(int signal)
+{
+    char data = (char) signal;
+    if (write(signalPipe[1], &data, 1) < 0)
+        return;
+}
+
+void printHelp()
+{
+    printf(
+        "Usage: batteryctld [options]\n"
+        "\n"
+        "   --socket (file)\t\tListen on another socket (" SOCKET_FILE ")\n"
+        "   --interval (seconds)\t\tRe-read the batteries this often besides uevents (5)\n"
+        "   --sysfs-root (dir)\t\tRead /sys from under another root\n"
+        "   --config (file)\t\tUse another configuration file\n"
+        "\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    int interval = SERVER_REFRESH_INTERVAL;
+
+    for (int i = 1; i < arguments.size(); i++) {
+        if (arguments[i] == "--help") {
+            printHelp();
+            return 0;
+        }
+        if (i + 1 >= arguments.size()) {
+            fprintf(stderr, "Missing value for %s, see --help\n", arguments[i].toLocal8Bit().constData());
+            return 1;
+        }
+        QString option = arguments[i];
+        QString value = arguments[++i];
+        if (option == "--socket")
+            Paths::setSocketFile(value);
+        else if (option == "--interval")
+            interval = value.toInt() * 1000;
+        else if (option == "--sysfs-root")
+            Paths::setSysfsRoot(value);
+        else if (option == "--config")
+            Paths::setConfigFile(value);
+        else {
+            fprintf(stderr, "Unknown option: %s, see --help\n", option.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    /* Leave the event loop on SIGTERM/SIGINT so the socket gets removed */
+    if (pipe2(signalPipe, O_CLOEXEC | O_NONBLOCK) < 0)
+        return 1;
+    signal(SIGTERM, handleSignal);
+    signal(SIGINT, handleSignal);
+    QSocketNotifier quit(signalPipe[0], QSocketNotifier::Read);
+    QObject::connect(&quit, SIGNAL(activated(int)), &app, SLOT(quit()));
+
+    Server server;
+    if (interval > 0)
+        server.setInterval(interval);
+    if (!server.listen(Paths::getSocketFile()))
+        return 1;
+
+    return app.exec();
+}
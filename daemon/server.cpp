@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "server.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include "core/fade.h"
+#include "core/protocol.h"
+#include "core/registry.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+Server::Server(QObject *parent) : QObject(parent), fd(-1), notifier(nullptr),
+    monitor(new UeventMonitor(this)), timer(new QTimer(this)), restoreTimer(new QTimer(this))
+{
+    connect(monitor, SIGNAL(supplyChanged(QString,QString)), this, SLOT(supplyChanged(QString,QString)));
+    connect(monitor, SIGNAL(overflowed()), this, SLOT(rescan()));
+    connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    connect(restoreTimer, SIGNAL(timeout()), this, SLOT(pollRestores()));
+
+    restoreTimer->setInterval(SERVER_RESTORE_POLL);
+
+    timer->setInterval(SERVER_REFRESH_INTERVAL);
+    timer->start();
+
+    rebuild();
+}
+
+Server::~Server()
+{
+    for (int client : connections.keys())
+        closeClient(client);
+
+    delete notifier;
+    if (fd >= 0) {
+        close(fd);
+        unlink(path.toLocal8Bit().constData());
+    }
+
+    qDeleteAll(batteries);
+}
+
+bool Server::listen(const QString &path)
+{
+    QByteArray file = path.toLocal8Bit();
+    struct sockaddr_un address;
+
+    if (file.size() >= (int) sizeof(address.sun_path)) {
+        qDebug() << "Socket path too long: " << path;
+        return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        qDebug() << "Error creating socket: " << strerror(errno);
+        return false;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, file.constData(), file.size());
+
+    /* A previous instance that was killed leaves its socket behind */
+    unlink(file.constData());
+
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0 || ::listen(fd, 16) < 0) {
+        qDebug() << "Error listening on " << path << ": " << strerror(errno);
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    /* Everybody may ask, handle() decides who may change anything */
+    chmod(file.constData(), 0666);
+
+    this->path = path;
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(acceptClient()));
+    return true;
+}
+
+void Server::setInterval(int msec)
+{
+    timer->setInterval(msec);
+}
+
+void Server::acceptClient()
+{
+    for (;;) {
+        int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                qDebug() << "Error accepting client: " << strerror(errno);
+            return;
+        }
+
+        struct ucred credentials;
+        socklen_t length = sizeof(credentials);
+        if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0) {
+            close(client);
+            continue;
+        }
+
+        /* Never let a stuck client block the daemon */
+        struct timeval timeout = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        Connection connection;
+        connection.uid = credentials.uid;
+        connection.restore = nullptr;
+        connection.notifier = new QSocketNotifier(client, QSocketNotifier::Read, this);
+        connect(connection.notifier, SIGNAL(activated(int)), this, SLOT(readClient(int)));
+        connections.insert(client, connection);
+    }
+}
+
+void Server::readClient(int fd)
+{
+    Connection &connection = connections[fd];
+    char buffer[PROTOCOL_MAX_REQUEST];
+
+    ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (size < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if (size <= 0) {
+        closeClient(fd);
+        return;
+    }
+
+    connection.buffer.append(buffer, size);
+
+    if (!processRequests(fd))
+        return;
+
+    if (connection.buffer.size() > PROTOCOL_MAX_REQUEST) {
+        QByteArray response = Protocol::error(Control::Error::InvalidArgument, "Request too long");
+        send(fd, response.constData(), response.size(), MSG_NOSIGNAL);
+        closeClient(fd);
+    }
+}
+
+/* Answers the complete lines buffered for fd; false once it was closed */
+bool Server::processRequests(int fd)
+{
+    Connection &connection = connections[fd];
+    int eol;
+
+    while (connection.restore == nullptr && (eol = connection.buffer.indexOf('\n')) >= 0) {
+        QByteArray response = handle(connection.buffer.left(eol), connection.uid, fd);
+        connection.buffer = connection.buffer.mid(eol + 1);
+
+        /* A restore was started, pollRestores() answers it */
+        if (response.isEmpty()) {
+            connection.notifier->setEnabled(false);
+            return true;
+        }
+
+        if (send(fd, response.constData(), response.size(), MSG_NOSIGNAL) != response.size()) {
+            closeClient(fd);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Server::pollRestores()
+{
+    bool pending = false;
+
+    for (int fd : connections.keys()) {
+        Connection &connection = connections[fd];
+        if (connection.restore == nullptr)
+            continue;
+        if (!connection.restore->isDone()) {
+            pending = true;
+            continue;
+        }
+
+        QByteArray response = Protocol::finishRestore(connection.restore);
+        delete connection.restore;
+        connection.restore = nullptr;
+        refresh();
+
+        if (send(fd, response.constData(), response.size(), MSG_NOSIGNAL) != response.size()) {
+            closeClient(fd);
+            continue;
+        }
+
+        connection.notifier->setEnabled(true);
+        if (processRequests(fd) && connections[fd].restore != nullptr)
+            pending = true;
+    }
+
+    if (!pending)
+        restoreTimer->stop();
+}
+
+void Server::closeClient(int fd)
+{
+    Connection connection = connections.value(fd);
+    connections.remove(fd);
+    /* Threads past their deadline are left to finish on their own */
+    delete connection.restore;
+    delete connection.notifier;
+    close(fd);
+}
+
+QByteArray Server::handle(const QByteArray &line, uid_t uid, int fd)
+{
+    QList<QByteArray> request = line.simplified().split(' ');
+    const QByteArray &command = request.first();
+
+    if (command == "INFO" && request.size() == 1)
+        return Protocol::ok(info);
+
+    if (!Protocol::isPrivileged(command))
+        return Protocol::execute(request);
+
+    if (uid != 0)
+        return Protocol::error(Control::Error::PermissionDenied, "Only root may change the charge thresholds");
+
+    if (command == "RESTORE") {
+        QByteArray response;
+        RestoreJob *job = Protocol::startRestore(request, &response);
+        if (job == nullptr)
+            return response;
+        connections[fd].restore = job;
+        restoreTimer->start();
+        return QByteArray();
+    }
+
+    QByteArray response = Protocol::execute(request);
+    refresh();
+    return response;
+}
+
+void Server::supplyChanged(QString name, QString action)
+{
+    Registry *registry = Registry::getRegistry();
+
+    if (action == "add" || action == "remove") {
+        if (action == "add" ? registry->add(name) : registry->remove(name))
+            rebuild();
+        return;
+    }
+
+    for (Battery *battery : batteries) {
+        if (battery->name == name) {
+            battery->readBattery(name);
+            encode();
+            return;
+        }
+    }
+
+    /* An AC adapter changed, which flips the status of every battery */
+    refresh();
+}
+
+/* Uevents were lost, so the device list may be stale */
+void Server::rescan()
+{
+    Registry::getRegistry()->scan();
+    rebuild();
+}
+
+void Server::refresh()
+{
+    for (Battery *battery : batteries)
+        battery->readBattery(battery->name);
+    encode();
+}
+
+void Server::rebuild()
+{
+    qDeleteAll(batteries);
+    batteries.clear();
+
+    for (const PowerSupply &supply : Registry::getRegistry()->getBatteries()) {
+        Battery *battery = new Battery();
+        battery->readBattery(supply.name);
+        batteries.append(battery);
+    }
+
+    encode();
+}
+
+void Server::encode()
+{
+    const QVector<PowerSupply> &supplies = Registry::getRegistry()->getBatteries();
+
+    int64_t now = QDateTime::currentMSecsSinceEpoch();
+
+    info.clear();
+    for (int i = 0; i < batteries.size() && i < supplies.size(); i++) {
+        Protocol::encodeBattery(*batteries[i], supplies[i].label(), &info);
+        FadeModel::getFadeModel()->update(*batteries[i], now);
+    }
+}
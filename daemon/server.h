@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <sys/types.h>
+
+#include "core/battery.h"
+#include "core/control.h"
+#include "core/ueventmonitor.h"
+
+#define SERVER_REFRESH_INTERVAL 5000
+/* How often a restore in flight is checked on */
+#define SERVER_RESTORE_POLL 20
+
+/*
+ * batteryctld: owns the samplers, the cached device state and the
+ * configuration, and answers Protocol requests on a Unix socket. INFO is
+ * served from a pre-encoded payload, anything that changes thresholds is
+ * only accepted from root. A RESTORE runs on its own threads and is
+ * polled from the event loop, so other clients are served meanwhile; the
+ * client that asked gets no further answers until it completes.
+ */
+class Server : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Server(QObject *parent = 0);
+    ~Server();
+
+    bool listen(const QString &path);
+    void setInterval(int msec);
+
+private slots:
+    void acceptClient();
+    void readClient(int fd);
+    void supplyChanged(QString name, QString action);
+    void rescan();
+    void refresh();
+    void pollRestores();
+
+private:
+    struct Connection {
+        QSocketNotifier *notifier;
+        QByteArray buffer;
+        uid_t uid;
+        RestoreJob *restore;
+    };
+
+    int fd;
+    QString path;
+    QSocketNotifier *notifier;
+    QHash<int, Connection> connections;
+    UeventMonitor *monitor;
+    QTimer *timer;
+    QTimer *restoreTimer;
+    QList<Battery *> batteries;
+    QByteArray info;
+
+    QByteArray handle(const QByteArray &line, uid_t uid, int fd);
+    bool processRequests(int fd);
+    void rebuild();
+    void encode();
+    void closeClient(int fd);
+};
+
+#endif // SERVER_H
@@ -8,22 +8,60 @@ QT       += core gui
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-TARGET = qbatteryctl
+TARGET = batteryctl-gui
 TEMPLATE = app
 
 SOURCES += \
-    main.cpp \
+    ui/main.cpp \
     core/storage.cpp \
     core/battery.cpp \
+    core/attributes.cpp \
+    core/sampler.cpp \
+    core/ueventmonitor.cpp \
+    core/registry.cpp \
+    core/paths.cpp \
+    core/control.cpp \
+    core/protocol.cpp \
+    core/client.cpp \
+    core/history.cpp \
+    core/archive.cpp \
+    core/query.cpp \
+    core/estimator.cpp \
+    core/fade.cpp \
+    core/serializer.cpp \
+    core/exporter.cpp \
+    core/scheduler.cpp \
+    core/sampleworker.cpp \
+    core/profiler.cpp \
     ui/batteryicon.cpp \
     ui/chargethreshold.cpp \
+    ui/helper.cpp \
     ui/mainwindow.cpp \
     ui/thinkpads_org_about.cpp
 
 HEADERS  += \
     core/storage.h \
     core/battery.h \
+    core/attributes.h \
+    core/sampler.h \
+    core/ueventmonitor.h \
+    core/registry.h \
+    core/paths.h \
+    core/control.h \
+    core/protocol.h \
+    core/client.h \
+    core/history.h \
+    core/archive.h \
+    core/query.h \
+    core/estimator.h \
+    core/fade.h \
+    core/serializer.h \
+    core/exporter.h \
+    core/scheduler.h \
+    core/sampleworker.h \
+    core/profiler.h \
     ui/chargethreshold.h \
+    ui/helper.h \
     ui/mainwindow.h \
     ui/batteryicon.h \
     ui/thinkpads_org_about.h
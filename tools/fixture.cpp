@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fixture.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define POWER_SUPPLY_FOLDER "/sys/class/power_supply/"
+#define SMAPI_FOLDER "/sys/devices/platform/smapi/"
+#define CONFIG_FOLDER "/etc/batteryctl/"
+
+static const char *manufacturers[] = { "SANYO", "LGC", "SONY", "Panasonic" };
+static const char *statuses[] = { "Discharging", "Charging", "Unknown", "Full" };
+
+Fixture::Fixture(const std::string &root) : batteries(2), mains(1), peripherals(0),
+    attributes(Fixture::Attributes::Full), smapi(false), root(root)
+{
+
+}
+
+bool Fixture::create()
+{
+    if (!makePath(root + POWER_SUPPLY_FOLDER) || !makePath(root + CONFIG_FOLDER))
+        return false;
+
+    for (int i = 0; i < batteries; i++)
+        if (!writeBattery(i, 0, true))
+            return false;
+
+    for (int i = 0; i < peripherals; i++)
+        if (!writePeripheral(i, 0, true))
+            return false;
+
+    for (int i = 0; i < mains; i++)
+        if (!writeMains(i, 0, true))
+            return false;
+
+    return true;
+}
+
+bool Fixture::churn(unsigned int tick)
+{
+    for (int i = 0; i < batteries; i++)
+        if (!writeBattery(i, tick, false))
+            return false;
+
+    for (int i = 0; i < peripherals; i++)
+        if (!writePeripheral(i, tick, false))
+            return false;
+
+    for (int i = 0; i < mains; i++)
+        if (!writeMains(i, tick, false))
+            return false;
+
+    return true;
+}
+
+std::string Fixture::getRoot() const
+{
+    return root;
+}
+
+std::string Fixture::getConfigFile() const
+{
+    return root + CONFIG_FOLDER + "values.conf";
+}
+
+bool Fixture::writeBattery(int index, unsigned int tick, bool create)
+{
+    std::string name = "BAT" + std::to_string(index);
+    std::string folder = root + POWER_SUPPLY_FOLDER + name + "/";
+
+    /* Values move deterministically with the tick, so runs are repeatable */
+    int capacity = 20 + (int) ((tick * 7 + index * 13) % 80);
+    int energyFullDesign = 57000000 - index * 3000000;
+    int energyFull = energyFullDesign - 4000000 - index * 1000000;
+    int energyNow = (int) ((long long) energyFull * capacity / 100);
+    int powerNow = 4000000 + (int) ((tick * 131 + index * 977) % 12000) * 1000;
+    int voltageNow = 11400000 + (int) ((tick * 17 + index * 5) % 1200) * 1000;
+    int cycles = 100 + index * 50 + (int) (tick / 1000);
+    const char *status = statuses[(tick / 10 + index) % 4];
+
+    if (create && !makePath(folder))
+        return false;
+
+    struct Value {
+        const char *attribute;
+        const char *key;
+        std::string data;
+        bool dynamic;
+    } values[] = {
+        { "capacity", "CAPACITY", std::to_string(capacity), true },
+        { "energy_now", "ENERGY_NOW", std::to_string(energyNow), true },
+        { "power_now", "POWER_NOW", std::to_string(powerNow), true },
+        { "voltage_now", "VOLTAGE_NOW", std::to_string(voltageNow), true },
+        { "status", "STATUS", status, true },
+        { "cycle_count", "CYCLE_COUNT", std::to_string(cycles), true },
+        { "energy_full", "ENERGY_FULL", std::to_string(energyFull), true },
+        { "present", "PRESENT", "1", false },
+        { "energy_full_design", "ENERGY_FULL_DESIGN", std::to_string(energyFullDesign), false },
+        { "voltage_min_design", "VOLTAGE_MIN_DESIGN", "10800000", false },
+        { "manufacturer", "MANUFACTURER", manufacturers[index % 4], false },
+        { "model_name", "MODEL_NAME", "45N1" + std::to_string(700 + index), false },
+        { "serial_number", "SERIAL_NUMBER", std::to_string(1000 + index * 37), false },
+        { "technology", "TECHNOLOGY", "Li-ion", false },
+    };
+
+    bool minimal = attributes == Fixture::Attributes::Minimal;
+    std::string uevent = "POWER_SUPPLY_NAME=" + name + "\n";
+
+    for (const Value &value : values) {
+        if (minimal && value.attribute != std::string("capacity") && value.attribute != std::string("status")
+                && value.attribute != std::string("present"))
+            continue;
+        if ((create || value.dynamic) && !writeFile(folder + value.attribute, value.data + "\n"))
+            return false;
+        uevent += std::string("POWER_SUPPLY_") + value.key + "=" + value.data + "\n";
+    }
+
+    if (create && !writeFile(folder + "type", "Battery\n"))
+        return false;
+
+    if (!minimal && create) {
+        if (!writeFile(folder + "charge_start_threshold", "0\n") || !writeFile(folder + "charge_stop_threshold", "100\n"))
+            return false;
+    }
+
+    /* Kernels before 5.9 do not export the thresholds in uevent */
+    if (attributes == Fixture::Attributes::Full)
+        uevent += "POWER_SUPPLY_CHARGE_CONTROL_START_THRESHOLD=0\nPOWER_SUPPLY_CHARGE_CONTROL_END_THRESHOLD=100\n";
+
+    if (!minimal && !writeFile(folder + "uevent", uevent))
+        return false;
+
+    if (smapi) {
+        std::string smapiFolder = root + SMAPI_FOLDER + name + "/";
+        if (create && !makePath(smapiFolder))
+            return false;
+        if (!writeFile(smapiFolder + "cycle_count", std::to_string(cycles) + "\n"))
+            return false;
+    }
+
+    return true;
+}
+
+bool Fixture::writePeripheral(int index, unsigned int tick, bool create)
+{
+    std::string name = "hidpp_battery_" + std::to_string(index);
+    std::string folder = root + POWER_SUPPLY_FOLDER + name + "/";
+    int capacity = 5 + (int) ((tick * 3 + index * 29) % 95);
+
+    if (create) {
+        if (!makePath(folder) || !writeFile(folder + "type", "Battery\n") || !writeFile(folder + "scope", "Device\n")
+                || !writeFile(folder + "present", "1\n") || !writeFile(folder + "model_name", "Wireless Mouse\n"))
+            return false;
+    }
+
+    std::string status = capacity > 90 ? "Full" : "Discharging";
+    return writeFile(folder + "capacity", std::to_string(capacity) + "\n")
+            && writeFile(folder + "status", status + "\n")
+            && writeFile(folder + "uevent", "POWER_SUPPLY_NAME=" + name + "\nPOWER_SUPPLY_SCOPE=Device\n"
+                         "POWER_SUPPLY_STATUS=" + status + "\nPOWER_SUPPLY_PRESENT=1\n"
+                         "POWER_SUPPLY_CAPACITY=" + std::to_string(capacity) + "\n");
+}
+
+bool Fixture::writeMains(int index, unsigned int tick, bool create)
+{
+    std::string name = index == 0 ? "AC" : "AC" + std::to_string(index);
+    std::string folder = root + POWER_SUPPLY_FOLDER + name + "/";
+    std::string online = (tick / 10) % 2 == 0 ? "1" : "0";
+
+    if (create && (!makePath(folder) || !writeFile(folder + "type", "Mains\n")))
+        return false;
+
+    return writeFile(folder + "online", online + "\n")
+            && writeFile(folder + "uevent", "POWER_SUPPLY_NAME=" + name + "\nPOWER_SUPPLY_ONLINE=" + online + "\n");
+}
+
+bool Fixture::makePath(const std::string &path)
+{
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i != path.size() && path[i] != '/')
+            continue;
+        std::string part = path.substr(0, i);
+        if (mkdir(part.c_str(), 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "Error creating %s: %s\n", part.c_str(), strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Fixture::writeFile(const std::string &path, const std::string &data)
+{
+    /* Overwrite in place, never replace the inode under an open descriptor */
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = pwrite(fd, data.data(), data.size(), 0) == (ssize_t) data.size()
+            && ftruncate(fd, data.size()) == 0;
+    if (!ok)
+        fprintf(stderr, "Error writing %s: %s\n", path.c_str(), strerror(errno));
+
+    close(fd);
+    return ok;
+}
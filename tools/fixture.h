@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FIXTURE_H
+#define FIXTURE_H
+
+#include <string>
+
+/*
+ * Builds a fake sysfs tree (power_supply devices, smapi cycle counters and
+ * an empty configuration directory) that batteryctl can be pointed at with
+ * --sysfs-root. Values are rewritten in place on churn, so descriptors that
+ * are held open across samples see the new contents just like on sysfs.
+ */
+class Fixture
+{
+public:
+
+    enum Attributes {
+        Full, Legacy, Minimal
+    };
+
+    explicit Fixture(const std::string &root);
+
+    int batteries;
+    int mains;
+    int peripherals;
+    Fixture::Attributes attributes;
+    bool smapi;
+
+    bool create();
+    bool churn(unsigned int tick);
+
+    std::string getRoot() const;
+    std::string getConfigFile() const;
+
+private:
+    std::string root;
+
+    bool writeBattery(int index, unsigned int tick, bool create);
+    bool writePeripheral(int index, unsigned int tick, bool create);
+    bool writeMains(int index, unsigned int tick, bool create);
+
+    static bool makePath(const std::string &path);
+    static bool writeFile(const std::string &path, const std::string &data);
+};
+
+#endif // FIXTURE_H
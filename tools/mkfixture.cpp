@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "fixture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void printHelp()
+{
+    printf(
+        "Usage: batteryctl-fixture --root (dir) [options]\n"
+        "\n"
+        "Creates a fake sysfs tree for batteryctl --sysfs-root.\n"
+        "\n"
+        "   --root (dir)\t\t\tWhere to create the tree\n"
+        "   --batteries (n)\t\tNumber of BATx laptop batteries (2)\n"
+        "   --peripherals (n)\t\tNumber of device scope batteries (0)\n"
+        "   --mains (n)\t\t\tNumber of AC adapters (1)\n"
+        "   --attributes (set)\t\tfull, legacy (no thresholds in uevent) or minimal (full)\n"
+        "   --smapi\t\t\tAlso create smapi cycle counters\n"
+        "   --churn (ms)\t\t\tKeep rewriting the dynamic values every ms milliseconds\n"
+        "   --ticks (n)\t\t\tStop churning after n rewrites (forever)\n"
+        "\n"
+    );
+}
+
+int main(int argc, char **argv)
+{
+    std::string root;
+    int churn = 0;
+    long ticks = -1;
+    int batteries = 2;
+    int peripherals = 0;
+    int mains = 1;
+    bool smapi = false;
+    Fixture::Attributes attributes = Fixture::Attributes::Full;
+
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(option, "--smapi") == 0) {
+            smapi = true;
+            continue;
+        }
+
+        if (strcmp(option, "--help") == 0) {
+            printHelp();
+            return 0;
+        }
+
+        if (value == nullptr) {
+            fprintf(stderr, "Missing value for %s, see --help\n", option);
+            return 1;
+        }
+        i++;
+
+        if (strcmp(option, "--root") == 0)
+            root = value;
+        else if (strcmp(option, "--batteries") == 0)
+            batteries = atoi(value);
+        else if (strcmp(option, "--peripherals") == 0)
+            peripherals = atoi(value);
+        else if (strcmp(option, "--mains") == 0)
+            mains = atoi(value);
+        else if (strcmp(option, "--churn") == 0)
+            churn = atoi(value);
+        else if (strcmp(option, "--ticks") == 0)
+            ticks = atol(value);
+        else if (strcmp(option, "--attributes") == 0) {
+            if (strcmp(value, "full") == 0)
+                attributes = Fixture::Attributes::Full;
+            else if (strcmp(value, "legacy") == 0)
+                attributes = Fixture::Attributes::Legacy;
+            else if (strcmp(value, "minimal") == 0)
+                attributes = Fixture::Attributes::Minimal;
+            else {
+                fprintf(stderr, "Unknown attribute set: %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s, see --help\n", option);
+            return 1;
+        }
+    }
+
+    if (root.empty()) {
+        printHelp();
+        return 1;
+    }
+
+    Fixture fixture(root);
+    fixture.batteries = batteries;
+    fixture.peripherals = peripherals;
+    fixture.mains = mains;
+    fixture.attributes = attributes;
+    fixture.smapi = smapi;
+
+    if (!fixture.create())
+        return 1;
+
+    printf("BATTERYCTL_SYSFS_ROOT=%s\nBATTERYCTL_CONFIG=%s\n", root.c_str(), fixture.getConfigFile().c_str());
+    fflush(stdout);
+
+    if (churn <= 0)
+        return 0;
+
+    for (unsigned int tick = 1; ticks < 0 || tick <= ticks; tick++) {
+        usleep(churn * 1000);
+        if (!fixture.churn(tick))
+            return 1;
+    }
+
+    return 0;
+}
@@ -27,6 +27,7 @@
 #include "batteryicon.h"
 
 #include <QPainter>
+#include <QPixmapCache>
 
 BatteryIcon::BatteryIcon(QWidget *parent = NULL) : QWidget(parent)
 {
@@ -35,8 +36,10 @@ BatteryIcon::BatteryIcon(QWidget *parent = NULL) : QWidget(parent)
 
 void BatteryIcon::setPercentage(int percentage)
 {
+    if (percentage == this->m_percentage)
+        return;
     this->m_percentage = percentage;
-    this->repaint();
+    this->update();
 }
 
 int BatteryIcon::percentage() const
@@ -48,10 +51,29 @@ void BatteryIcon::paintEvent(QPaintEvent *event)
 {
     (void)event;
 
+    double ratio = devicePixelRatioF();
+    QString key = QString("batteryicon-%1x%2@%3-%4").arg(width()).arg(height()).arg(ratio).arg(m_percentage);
+    QPixmap pixmap;
+
+    if (!QPixmapCache::find(key, &pixmap)) {
+        pixmap = render(width(), height(), ratio, m_percentage);
+        QPixmapCache::insert(key, pixmap);
+    }
+
     QPainter painter(this);
+    painter.drawPixmap(0, 0, pixmap);
+}
+
+QPixmap BatteryIcon::render(int widgetWidth, int widgetHeight, double ratio, int percentage)
+{
+    QPixmap pixmap(qRound(widgetWidth * ratio), qRound(widgetHeight * ratio));
+    pixmap.setDevicePixelRatio(ratio);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
 
-    int width = this->width() - 8;
-    int height = this->height();
+    int width = widgetWidth - 8;
+    int height = widgetHeight;
     int margin = 0;
 
     QLinearGradient background(0, 0, 0, height / 2);
@@ -65,7 +87,7 @@ void BatteryIcon::paintEvent(QPaintEvent *event)
 
     QLinearGradient fill(0, 0, 0, height / 0.5);
 
-    if (m_percentage < 20) {
+    if (percentage < 20) {
         fill.setColorAt(0, QColor("#f0ad6d"));
         fill.setColorAt(1, QColor("#cb7c00"));
     } else {
@@ -78,7 +100,7 @@ void BatteryIcon::paintEvent(QPaintEvent *event)
 
     int fillMargin = margin + 3;
     painter.drawRect(fillMargin, fillMargin, (width -
-                     (2 * fillMargin)) * (m_percentage / 100.0f), height - (2 * fillMargin) - 1);
+                     (2 * fillMargin)) * (percentage / 100.0f), height - (2 * fillMargin) - 1);
 
     brush = QBrush();
     brush.setColor(QColor("#000000"));
@@ -94,6 +116,8 @@ void BatteryIcon::paintEvent(QPaintEvent *event)
 
     painter.setFont(QFont("arial", height / 3));
     painter.drawText(0, 0, width, height, Qt::AlignCenter,
-                     QString::number(m_percentage) + QString("%")); // I love c++
+                     QString::number(percentage) + QString("%"));
 
+    painter.end();
+    return pixmap;
 }
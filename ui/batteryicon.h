@@ -27,13 +27,19 @@
 #ifndef BATTERYICON_H
 #define BATTERYICON_H
 
+#include <QPixmap>
 #include <QWidget>
 
+/*
+ * The battery gauge. Each size and percentage is drawn once into a
+ * pixmap kept in QPixmapCache, a paint only blits it.
+ */
 class BatteryIcon : public QWidget
 {
     Q_OBJECT
 private:
     int m_percentage;
+    static QPixmap render(int width, int height, double ratio, int percentage);
 public:
     BatteryIcon(QWidget *parent);
     int percentage() const;
@@ -24,14 +24,14 @@
  * POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <stdlib.h>
-
 #include <QDebug>
 #include <QMessageBox>
 
 #include "chargethreshold.h"
 #include "ui_chargethreshold.h"
 #include "core/storage.h"
+#include "core/control.h"
+#include "helper.h"
 
 ChargeThreshold::ChargeThreshold(QWidget *parent) : QDialog(parent)
 {
@@ -44,11 +44,7 @@ ChargeThreshold::ChargeThreshold(QWidget *parent) : QDialog(parent)
     connect(ui->ok_button, SIGNAL(clicked(bool)), this, SLOT(saveSettings()));
     connect(ui->cancel_button, SIGNAL(clicked(bool)), this, SLOT(close()));
     connect(ui->battery_chooser, SIGNAL(activated(int)), this, SLOT(restoreSettings()));
-
-    if (Battery::isPrimaryAvailable())
-        ui->battery_chooser->addItem(PRIMARY);
-    if (Battery::isSecondaryAvailable())
-       ui->battery_chooser->addItem(SECONDARY);
+    connect(Helper::getHelper(), SIGNAL(finished(int,QString)), this, SLOT(settingsSaved(int,QString)));
 
     connect(ui->start, SIGNAL(valueChanged(int)), this, SLOT(forceConstraintStart()));
     connect(ui->stop, SIGNAL(valueChanged(int)), this, SLOT(forceConstraintStop()));
@@ -57,6 +53,25 @@ ChargeThreshold::ChargeThreshold(QWidget *parent) : QDialog(parent)
 
 }
 
+/* The batteries come from the window, the registry belongs to its sampling thread */
+void ChargeThreshold::setSupplies(const QVector<PowerSupply> &supplies)
+{
+    QString backup = ui->battery_chooser->currentData().toString();
+
+    ui->battery_chooser->clear();
+    for (const PowerSupply &supply : supplies)
+        if (supply.wearControl)
+            ui->battery_chooser->addItem(supply.label(), supply.name);
+
+    int index = ui->battery_chooser->findData(backup);
+    if (index >= 0)
+        ui->battery_chooser->setCurrentIndex(index);
+
+    /* Never overwrite what the user is editing */
+    if (!isVisible())
+        restoreSettings();
+}
+
 ChargeThreshold::~ChargeThreshold()
 {
     delete ui;
@@ -72,49 +87,52 @@ void ChargeThreshold::customClicked(bool state)
 
 void ChargeThreshold::saveSettings()
 {
-
-    QString battery = QString(" %1 ").arg(Battery::stringFromLocationConsole(
-                                              Battery::locationFromString(
-                                                  ui->battery_chooser->currentText())));
-    QString cmd = "batteryctl";
+    QByteArray battery = ui->battery_chooser->currentData().toString().toUtf8();
+    QByteArray request;
 
     if (ui->always->isChecked())
-        cmd += " preset " + battery + SETTING_AC_FULL;
+        request = "PRESET " + battery + " " SETTING_AC_FULL;
     if (ui->always_ac->isChecked())
-        cmd += " preset " + battery + SETTING_AC;
+        request = "PRESET " + battery + " " SETTING_AC;
     if (ui->life->isChecked())
-        cmd += " preset " + battery + SETTING_LIFE;
-    if (ui->custom->isChecked()) {
-        cmd += " set " + battery + QString::number(ui->start->value()) + " " + QString::number(ui->stop->value());
-    }
+        request = "PRESET " + battery + " " SETTING_LIFE;
+    if (ui->custom->isChecked())
+        request = "SET " + battery + " " + QByteArray::number(ui->start->value())
+                + " " + QByteArray::number(ui->stop->value());
 
-    int ret = system(QString("pkexec " + cmd).toStdString().c_str());
+    if (battery.isEmpty() || request.isEmpty())
+        return;
 
-    if (ret == -1)
-        QMessageBox::critical(this, "ACPI error in batteryctl",
-                              "The child process pkexec failed to execute.\n\n"
-                              "Click Ok to close this message.", QMessageBox::Ok);
-
-    if (ret == 127)
-        QMessageBox::critical(this, "ACPI error in batteryctl",
-                              "The child process shell could not be created.\n\n"
-                              "Click Ok to close this message.", QMessageBox::Ok);
+    ui->ok_button->setEnabled(false);
+    Helper::getHelper()->request(request);
+}
 
-    if (ret != 0)
-        QMessageBox::critical(this, "ACPI error in batteryctl",
-                              "The child process was created but it failed to configure the batteries.\n\n("
-                              + cmd +
-                              ")\n\nClick Ok to close this message.", QMessageBox::Ok);
+void ChargeThreshold::settingsSaved(int code, const QString &message)
+{
+    ui->ok_button->setEnabled(true);
+
+    if (code != Control::Error::NoError) {
+        QMessageBox *box = new QMessageBox(QMessageBox::Critical, "ACPI error in batteryctl",
+                                           QString("Could not configure the batteries (error %1).\n\n%2\n\n"
+                                                   "Click Ok to close this message.").arg(code).arg(message),
+                                           QMessageBox::Ok, this);
+        box->setAttribute(Qt::WA_DeleteOnClose);
+        box->open();
+        return;
+    }
 
     close();
 }
 
 void ChargeThreshold::restoreSettings()
 {
-    Battery::BatteryLocation location = Battery::locationFromString(ui->battery_chooser->currentText());
+    QString name = ui->battery_chooser->currentData().toString();
     Storage *storage = Storage::getStorage();
 
-    QString type = storage->getSettingType(location);
+    if (name.isEmpty())
+        return;
+
+    QString type = storage->getSettingType(name);
 
     if (type == SETTING_AC)
         ui->always_ac->click();
@@ -124,8 +142,8 @@ void ChargeThreshold::restoreSettings()
         ui->life->click();
     if (type == SETTING_CUSTOM) {
         ui->custom->click();
-        ui->start->setValue(storage->getStartThreshold(location));
-        ui->stop->setValue(storage->getStopThreshold(location));
+        ui->start->setValue(storage->getStartThreshold(name));
+        ui->stop->setValue(storage->getStopThreshold(name));
     }
 
 }
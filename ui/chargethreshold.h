@@ -29,6 +29,9 @@
 
 #include <QDialog>
 #include <QSettings>
+#include <QVector>
+
+#include "core/registry.h"
 
 namespace Ui {
 class ChargeThreshold;
@@ -42,9 +45,12 @@ public:
     explicit ChargeThreshold(QWidget *parent = 0);
     ~ChargeThreshold();
 
+    void setSupplies(const QVector<PowerSupply> &supplies);
+
 private slots:
     void customClicked(bool state);
     void saveSettings();
+    void settingsSaved(int code, const QString &message);
     void restoreSettings();
     void forceConstraintStart();
     void forceConstraintStop();
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QDebug>
+#include <QStringList>
+
+#include "helper.h"
+#include "core/control.h"
+#include "core/protocol.h"
+
+/* pkexec exit codes for a dismissed or refused authentication */
+#define PKEXEC_NOT_AUTHORIZED 127
+#define PKEXEC_DISMISSED 126
+
+Helper *Helper::instance = nullptr;
+
+Helper *Helper::getHelper()
+{
+    if (instance == nullptr)
+        instance = new Helper();
+    return instance;
+}
+
+Helper::Helper()
+{
+    process = new QProcess(this);
+    pending = 0;
+
+    connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readResponses()));
+    connect(process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(processFinished(int)));
+    connect(process, SIGNAL(errorOccurred(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+}
+
+bool Helper::isBusy() const
+{
+    return pending > 0;
+}
+
+void Helper::start()
+{
+    buffer.clear();
+    process->start(HELPER_PROGRAM, QStringList() << HELPER_COMMAND << "helper");
+}
+
+void Helper::request(const QByteArray &line)
+{
+    /* Lines written before pkexec authenticates wait in the pipe */
+    if (process->state() == QProcess::NotRunning)
+        start();
+
+    pending++;
+    process->write(line + "\n");
+}
+
+void Helper::readResponses()
+{
+    buffer.append(process->readAllStandardOutput());
+
+    while (pending > 0) {
+        int newline = buffer.indexOf('\n');
+        if (newline < 0)
+            return;
+
+        int length;
+        QString message;
+        int code = Protocol::parseHeader(buffer.left(newline), &length, &message);
+
+        if (buffer.size() < newline + 1 + length)
+            return;
+
+        if (code == Control::Error::NoError)
+            message = QString::fromUtf8(buffer.mid(newline + 1, length));
+
+        buffer.remove(0, newline + 1 + length);
+        pending--;
+        emit finished(code, message);
+    }
+}
+
+void Helper::failPending(const QString &message)
+{
+    while (pending > 0) {
+        pending--;
+        emit finished(Control::Error::Unreachable, message);
+    }
+}
+
+void Helper::processFinished(int exitCode)
+{
+    /* Restarted by the next request */
+    if (exitCode == PKEXEC_NOT_AUTHORIZED || exitCode == PKEXEC_DISMISSED)
+        failPending("Authorization for changing the thresholds was not granted.");
+    else
+        failPending(QString("The privileged helper exited unexpectedly (%1).").arg(exitCode));
+}
+
+void Helper::processError(QProcess::ProcessError error)
+{
+    if (error != QProcess::FailedToStart)
+        return;
+
+    qDebug() << "Could not start" << HELPER_PROGRAM << ":" << process->errorString();
+    failPending("The privileged helper could not be started: " + process->errorString());
+}
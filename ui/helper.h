@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017 Ognjen Galić
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HELPER_H
+#define HELPER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+#include <QString>
+
+#define HELPER_PROGRAM "pkexec"
+#define HELPER_COMMAND "batteryctl"
+
+/*
+ * Privileged side channel of the GUI. One "pkexec batteryctl helper" is
+ * started on the first request and kept for the rest of the session, so
+ * polkit asks once; requests and responses use the batteryctld protocol
+ * over the helper's stdin and stdout.
+ */
+class Helper : public QObject
+{
+    Q_OBJECT
+
+public:
+    static Helper *getHelper();
+
+    void request(const QByteArray &line);
+    bool isBusy() const;
+
+signals:
+    void finished(int code, const QString &message);
+
+private slots:
+    void readResponses();
+    void processFinished(int exitCode);
+    void processError(QProcess::ProcessError error);
+
+private:
+    Helper();
+    void start();
+    void failPending(const QString &message);
+
+    static Helper *instance;
+
+    QProcess *process;
+    QByteArray buffer;
+    int pending;
+};
+
+#endif // HELPER_H
@@ -2,158 +2,239 @@
 #include "ui_mainwindow.h"
 #include "thinkpads_org_about.h"
 
+#include "core/attributes.h"
+
 #include <QMessageBox>
+#include <QPixmapCache>
 #include <QDesktopServices>
+#include <QHBoxLayout>
 #include <QUrl>
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
-    ui(new Ui::MainWindow), refresh(new QTimer())
+    ui(new Ui::MainWindow), wearControl(false), watching(true), worker(new SampleWorker())
 {
     ui->setupUi(this);
 
-    ui->primary_battery->setVisible(false);
-    ui->secondary_battery->setVisible(false);
+    thresholds = new ChargeThreshold();
+    connect(ui->maintain, SIGNAL(clicked(bool)), thresholds, SLOT(open()));
 
-    evaluateBatteries();
-    refreshData();
+    /* Every sysfs read happens on the sampling thread, we only get copies */
+    SampleWorker::registerTypes();
+    worker->moveToThread(&sampling);
+    connect(&sampling, SIGNAL(started()), worker, SLOT(start()));
+    connect(&sampling, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    connect(worker, SIGNAL(suppliesChanged(PowerSupplies,bool)), this, SLOT(suppliesChanged(PowerSupplies,bool)));
+    connect(worker, SIGNAL(batterySampled(BatterySnapshot)), this, SLOT(batterySampled(BatterySnapshot)));
+    connect(this, SIGNAL(visibilityChanged(bool)), worker, SLOT(setVisible(bool)));
+    sampling.start();
 
-    connect(refresh, SIGNAL(timeout()), this, SLOT(refreshData()));
+}
 
-    this->refresh->setInterval(3000);
-    this->refresh->start();
+void MainWindow::suppliesChanged(const PowerSupplies &supplies, bool wearControl)
+{
+    this->supplies = supplies;
+    this->wearControl = wearControl;
 
-    thresholds = new ChargeThreshold();
-    connect(ui->maintain, SIGNAL(clicked(bool)), thresholds, SLOT(open()));
+    ui->maintain->setEnabled(wearControl);
+    thresholds->setSupplies(supplies);
 
+    rebuildBatteries();
+    refreshData();
 }
 
-void MainWindow::evaluateBatteries()
+void MainWindow::batterySampled(const BatterySnapshot &battery)
 {
-    ui->battery_combo->clear();
-    QString backup = ui->battery_combo->currentText();
-
-    if (Battery::isWearControlSupported(Battery::BatteryLocation::Primary) ||
-            Battery::isWearControlSupported(Battery::BatteryLocation::Secondary))
-        ui->maintain->setEnabled(true);
-
-    if (Battery::isPrimaryAvailable()) {
-        if (primary == nullptr)
-            primary = new Battery();
-        primary->readBattery(Battery::BatteryLocation::Primary);
-        ui->battery_combo->addItem(PRIMARY);
-    } else {
-        if (primary != nullptr)
-            delete primary;
-        primary = nullptr;
+    /* A device removed since this was read has no slot anymore */
+    for (int i = 0; i < supplies.size(); i++) {
+        if (supplies[i].name == battery->name) {
+            batteries[i] = battery;
+            displayBatteries();
+            return;
+        }
     }
+}
 
-    if (Battery::isSecondaryAvailable()) {
-        if (secondary == nullptr)
-            secondary = new Battery();
-        secondary->readBattery(Battery::BatteryLocation::Secondary);
-        ui->battery_combo->addItem(SECONDARY);
-    } else {
-        if (secondary != nullptr)
-            delete secondary;
-        secondary = nullptr;
+void MainWindow::rebuildBatteries()
+{
+    QString backup = ui->battery_combo->currentData().toString();
+
+    batteries.clear();
+
+    for (const BatteryCondition &condition : conditions)
+        delete condition.widget;
+    conditions.clear();
+
+    for (const PowerSupply &supply : supplies) {
+        batteries.append(BatterySnapshot());
+
+        BatteryCondition condition;
+        condition.widget = new QWidget();
+        condition.icon = new QLabel();
+        condition.icon->setFixedSize(20, 11);
+        condition.text = new QLabel();
+
+        QHBoxLayout *layout = new QHBoxLayout(condition.widget);
+        layout->setSpacing(0);
+        layout->setContentsMargins(0, 0, 0, 0);
+        layout->addWidget(new QLabel(supply.label()));
+        layout->addSpacing(5);
+        layout->addWidget(condition.icon);
+        layout->addSpacing(6);
+        layout->addWidget(condition.text);
+
+        ui->conditions->addWidget(condition.widget);
+        conditions.append(condition);
     }
 
-    ui->battery_combo->setCurrentText(backup);
+    ui->battery_combo->blockSignals(true);
+    ui->battery_combo->clear();
+    for (const PowerSupply &supply : supplies)
+        ui->battery_combo->addItem(supply.label(), supply.name);
+    int index = ui->battery_combo->findData(backup);
+    if (index >= 0)
+        ui->battery_combo->setCurrentIndex(index);
+    ui->battery_combo->blockSignals(false);
 }
 
-void MainWindow::displayBatteryInfo(Battery &battery)
+const Battery *MainWindow::findBattery(const QString &name)
 {
-    /*
-     * Status, Remaining Percentage, Remaining capacity, Full capacity, Current, Voltage, Wattage, Cycles
-     */
+    for (const BatterySnapshot &battery : batteries)
+        if (!battery.isNull() && battery->name == name)
+            return battery.data();
+    return nullptr;
+}
 
-    this->ui->battery_info->setText(QString("%1\n%2\n%3\n%4\n%5\n%6\n%7\n%8").arg(
-                                        battery.status,
-                                        QString::number(battery.capacity) + " %",
-                                        battery.energy_now == 0 ? "-" : QString::number(battery.energy_now / 1000000.0f) + " Wh",
-                                        battery.energy_full == 0 ? "-" : QString::number(battery.energy_full/ 1000000.0f) + " Wh",
-                                        battery.power_now == 0 ? "-" : QString::number((battery.power_now / (float) battery.voltage_now)) + " A",
-                                        battery.voltage_now == 0 ? "-" : QString::number(battery.voltage_now / 1000000.0f) + " V",
-                                        battery.power_now == 0 ? "-" : QString::number(battery.power_now / 1000000.0f) + " W",
-                                        battery.cycle_count == 0 ? "-" : QString::number(battery.cycle_count)));
+/* Rows of the two value columns, in the order of the labels in mainwindow.ui */
+static constexpr int info[] = {
+    Attributes::indexOf("status"), Attributes::indexOf("capacity"), Attributes::indexOf("energy_now"),
+    Attributes::indexOf("energy_full"), Attributes::indexOf("current_now"), Attributes::indexOf("voltage_now"),
+    Attributes::indexOf("power_now"), Attributes::indexOf("cycle_count"), Attributes::indexOf("time_to_empty"),
+    Attributes::indexOf("time_to_full")
+};
+
+static constexpr int manufacturer[] = {
+    Attributes::indexOf("manufacturer"), Attributes::indexOf("serial_number"), Attributes::indexOf("model_name"),
+    Attributes::indexOf("technology"), Attributes::indexOf("energy_full_design"), Attributes::indexOf("voltage_min_design")
+};
+
+/*
+ * Setting the same text or pixmap again still relayouts and repaints a
+ * label, so only hand over what actually changed.
+ */
+static void setLabelText(QLabel *label, const QString &text)
+{
+    if (label->text() != text)
+        label->setText(text);
+}
 
-    this->ui->battery_manu->setText(QString("%1\n%2\n%3\n%4\n%5\n%6").arg(
-                                        battery.manufacturer,
-                                        battery.serial_number,
-                                        battery.model_name,
-                                        battery.technology,
-                                        QString::number(battery.energy_full_design / 1000000.0f) + "Wh",
-                                        QString::number(battery.voltage_min_design / 1000000.0f) + "V"));
+static void setLabelPixmap(QLabel *label, const QPixmap &pixmap)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    qint64 key = label->pixmap(Qt::ReturnByValue).cacheKey();
+#else
+    const QPixmap *current = label->pixmap();
+    qint64 key = current == nullptr ? 0 : current->cacheKey();
+#endif
+    if (key != pixmap.cacheKey())
+        label->setPixmap(pixmap);
+}
 
-    this->ui->manu_logo->setPixmap(getManufacturerLogo(battery.manufacturer));
+/* Decoded once, later calls share the same pixmap and cacheKey() */
+static QPixmap loadPixmap(const QString &resource)
+{
+    QPixmap pixmap;
+    if (!QPixmapCache::find(resource, &pixmap)) {
+        pixmap = QPixmap(resource);
+        QPixmapCache::insert(resource, pixmap);
+    }
+    return pixmap;
+}
 
+static QString formatColumn(const Battery &battery, const int *rows, int count)
+{
+    QStringList lines;
+    for (int i = 0; i < count; i++)
+        lines << Attributes::format(battery, rows[i]);
+    return lines.join("\n");
 }
 
-void MainWindow::displayCondition()
+void MainWindow::displayBatteryInfo(const Battery &battery)
 {
-    ui->primary_battery->setVisible(false);
-    ui->secondary_battery->setVisible(false);
+    setLabelText(ui->battery_info, formatColumn(battery, info, sizeof(info) / sizeof(info[0])));
+    setLabelText(ui->battery_manu, formatColumn(battery, manufacturer, sizeof(manufacturer) / sizeof(manufacturer[0])));
 
-    if (primary != nullptr) {
-        ui->primary_battery->setVisible(true);
-        ui->primary_icon->setPixmap(getBatteryHealthIcon(primary));
-        ui->primary_text->setText(getBatteryHealth(primary));
-    }
+    setLabelPixmap(ui->manu_logo, getManufacturerLogo(battery.manufacturer));
 
-    if (secondary != nullptr) {
-        ui->secondary_battery->setVisible(true);
-        ui->secondary_icon->setPixmap(getBatteryHealthIcon(secondary));
-        ui->secondary_text->setText(getBatteryHealth(secondary));
+}
+
+void MainWindow::displayCondition()
+{
+    bool damaged = false;
+
+    for (int i = 0; i < batteries.size(); i++) {
+        if (batteries[i].isNull())
+            continue;
+        /* Peripherals and batteries without a design capacity have no health to rate */
+        bool rated = supplies[i].scope != PowerSupply::Scope::DeviceScope && batteries[i]->energy_full_design != 0;
+        QString health = rated ? getBatteryHealth(batteries[i].data()) : "-";
+        if (conditions[i].text->text() != health) {
+            conditions[i].icon->setPixmap(rated ? getBatteryHealthIcon(batteries[i].data()) : QPixmap());
+            conditions[i].text->setText(health);
+        }
+        if (rated && batteries[i]->health < 30)
+            damaged = true;
     }
+
+    displayDamaged(damaged);
 }
 
-QPixmap MainWindow::getBatteryHealthIcon(Battery *health)
+QPixmap MainWindow::getBatteryHealthIcon(const Battery *health)
 {
     if (health->health < 10)
-        return QPixmap(":/res/bad.png");
+        return loadPixmap(":/res/bad.png");
     if (health->health < 30)
-        return QPixmap(":/res/fair.png");
-    return QPixmap(":/res/good.png");
+        return loadPixmap(":/res/fair.png");
+    return loadPixmap(":/res/good.png");
 }
 
-QString MainWindow::getBatteryHealth(Battery *health)
+QString MainWindow::getBatteryHealth(const Battery *health)
 {
-    if (health->health < 10) {
-        displayDamaged(true);
+    if (health->health < 10)
         return "Poor";
-    }
-    if (health->health < 30) {
-        displayDamaged(true);
+    if (health->health < 30)
         return "Fair";
-    }
-    displayDamaged(false);
     return "Good";
 }
 
 void MainWindow::displayDamaged(bool damaged)
 {
     if (damaged)
-        ui->status->document()->setPlainText(("One of the batteries is in poor condition. Consider replacing the battery."));
-    else if (!(Battery::isWearControlSupported(Battery::BatteryLocation::Primary) ||
-             Battery::isWearControlSupported(Battery::BatteryLocation::Secondary)))
-        ui->status->document()->setPlainText(("The batteries are in good condition. "
-                                              "Setting of the thresholds is only supported on Sandy Bridge"
-                                              " Lenovo ThinkPad laptops or newer, and on Linux 4.17."));
+        displayStatus("One of the batteries is in poor condition. Consider replacing the battery.");
+    else if (!wearControl)
+        displayStatus("The batteries are in good condition. "
+                      "Setting of the thresholds is only supported on Sandy Bridge"
+                      " Lenovo ThinkPad laptops or newer, and on Linux 4.17.");
     else
-        ui->status->document()->setPlainText(("The batteries are in good condition."));
+        displayStatus("The batteries are in good condition.");
+}
+
+void MainWindow::displayStatus(const QString &text)
+{
+    /* Replacing the document resets its layout and scroll position */
+    if (ui->status->document()->toPlainText() != text)
+        ui->status->document()->setPlainText(text);
 }
 
 void MainWindow::removeAllBatteries()
 {
     ui->battery->setPercentage(0);
-    ui->battery_combo->clear();
-    ui->status->document()->setPlainText("No batteries are installed.");
-    ui->battery_info->setText("-\n-\n-\n-\n-\n-\n-\n-");
-    ui->battery_manu->setText("-\n-\n-\n-\n-\n-");
-    ui->primary_battery->setVisible(false);
-    ui->secondary_battery->setVisible(false);
+    if (ui->battery_combo->count() > 0)
+        ui->battery_combo->clear();
+    displayStatus("No batteries are installed.");
+    setLabelText(ui->battery_info, "-\n-\n-\n-\n-\n-\n-\n-\n-\n-");
+    setLabelText(ui->battery_manu, "-\n-\n-\n-\n-\n-");
     ui->maintain->setEnabled(false);
-    ui->manu_logo->setPixmap(QPixmap());
+    setLabelPixmap(ui->manu_logo, QPixmap());
 }
 
 void MainWindow::displayTotalRemaining()
@@ -161,14 +242,12 @@ void MainWindow::displayTotalRemaining()
     int max = 0;
     int current = 0;
 
-    if (primary != nullptr) {
+    /* Peripheral batteries do not power the laptop */
+    for (int i = 0; i < batteries.size(); i++) {
+        if (batteries[i].isNull() || supplies[i].scope == PowerSupply::Scope::DeviceScope)
+            continue;
         max += 100;
-        current += primary->capacity;
-    }
-
-    if (secondary != nullptr) {
-        max += 100;
-        current += secondary->capacity;
+        current += batteries[i]->capacity;
     }
 
     if (max == 0) {
@@ -183,32 +262,28 @@ QPixmap MainWindow::getManufacturerLogo(QString manufacturer)
 {
     QString lower = manufacturer.toLower();
     if (lower.contains("lg"))
-        return QPixmap(":/res/lgc.png");
+        return loadPixmap(":/res/lgc.png");
     if (lower.contains("sanyo"))
-        return QPixmap(":/res/sanyo.png");
+        return loadPixmap(":/res/sanyo.png");
     if (lower.contains("sony"))
-        return QPixmap(":/res/sony.png");
+        return loadPixmap(":/res/sony.png");
     if (lower.contains("pan"))
-        return QPixmap(":/res/panasonic.png");
+        return loadPixmap(":/res/panasonic.png");
     return QPixmap();
 }
 
 
-void MainWindow::displaySelectedBattery(QString bat)
+/* The combo's item data is the device name, its text is only the label */
+void MainWindow::displaySelectedBattery()
 {
-    if (primary == nullptr && secondary == nullptr) {
+    if (batteries.isEmpty()) {
         removeAllBatteries();
         return;
     }
 
-    if (bat == PRIMARY)
-        if (primary != nullptr)
-            displayBatteryInfo(*primary);
-
-    if (bat == SECONDARY)
-        if (secondary != nullptr)
-            displayBatteryInfo(*secondary);
-
+    const Battery *battery = findBattery(ui->battery_combo->currentData().toString());
+    if (battery != nullptr)
+        displayBatteryInfo(*battery);
 }
 
 void MainWindow::openSite()
@@ -223,22 +298,52 @@ void MainWindow::openAbout()
 
 void MainWindow::refreshData()
 {
-    evaluateBatteries();
-    QString data = ui->battery_combo->currentText();
-    if (data == "") {
+    if (batteries.isEmpty())
         removeAllBatteries();
+    else
+        displayBatteries();
+}
+
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    setWatching(true);
+}
+
+void MainWindow::hideEvent(QHideEvent *event)
+{
+    QMainWindow::hideEvent(event);
+    setWatching(false);
+}
+
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+
+    /* A minimized window gets no hide event */
+    if (event->type() == QEvent::WindowStateChange)
+        setWatching(!isMinimized());
+}
+
+void MainWindow::setWatching(bool watching)
+{
+    if (watching == this->watching)
         return;
-    }
-    displaySelectedBattery(data);
+    this->watching = watching;
+    emit visibilityChanged(watching);
+}
+
+void MainWindow::displayBatteries()
+{
+    displaySelectedBattery();
     displayTotalRemaining();
     displayCondition();
 }
 
-
 MainWindow::~MainWindow()
 {
+    sampling.quit();
+    sampling.wait();
     delete ui;
-    refresh->stop();
-    delete refresh;
 }
 
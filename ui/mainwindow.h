@@ -2,9 +2,12 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTimer>
+#include <QThread>
+#include <QLabel>
+#include <QList>
 
 #include "core/battery.h"
+#include "core/sampleworker.h"
 #include "chargethreshold.h"
 #include "thinkpads_org_about.h"
 
@@ -24,24 +27,49 @@ private:
     Ui::MainWindow *ui;
     thinkpads_org_about about;
 
-    Battery *primary = nullptr;
-    Battery *secondary = nullptr;
+    struct BatteryCondition {
+        QWidget *widget;
+        QLabel *icon;
+        QLabel *text;
+    };
+
+    /* In the order of supplies, null until a device was first sampled */
+    QList<BatterySnapshot> batteries;
+    PowerSupplies supplies;
+    bool wearControl;
+    bool watching;
+    QList<BatteryCondition> conditions;
     ChargeThreshold *thresholds;
-    QTimer *refresh;
+    QThread sampling;
+    SampleWorker *worker;
 
-    void evaluateBatteries();
-    void displayBatteryInfo(Battery &battery);
+    void setWatching(bool watching);
+    void rebuildBatteries();
+    const Battery *findBattery(const QString &name);
+    void displayBatteries();
+    void displayBatteryInfo(const Battery &battery);
     void displayCondition();
     void displayDamaged(bool damaged);
+    void displayStatus(const QString &text);
     void removeAllBatteries();
     void displayTotalRemaining();
     static QPixmap getManufacturerLogo(QString manufacturer);
-    QPixmap getBatteryHealthIcon(Battery *health);
-    QString getBatteryHealth(Battery *battery);
+    QPixmap getBatteryHealthIcon(const Battery *health);
+    QString getBatteryHealth(const Battery *battery);
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    void changeEvent(QEvent *event);
+
+signals:
+    void visibilityChanged(bool visible);
 
 public slots:
     void refreshData();
-    void displaySelectedBattery(QString bat);
+    void suppliesChanged(const PowerSupplies &supplies, bool wearControl);
+    void batterySampled(const BatterySnapshot &battery);
+    void displaySelectedBattery();
     void openSite();
     void openAbout();
 